@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#include "../../workflows/actuators.hpp"
+#include "../../workflows/detail/log.hpp"
+
+LLWFLOWS_NS_USING
+
+#if LLWFLOWS_CPP_PLUS >= 20
+static_assert(Executor<InlineExecutor>);
+static_assert(Executor<SingleThreadExecutor>);
+static_assert(Executor<PoolExecutor>);
+static_assert(Executor<StrandExecutor>);
+static_assert(!Executor<ThreadPool>);
+#endif
+
+template <typename E>
+static auto sumOf(E& executor, const std::size_t count, const std::size_t grain) -> long long {
+    std::atomic<long long> sum{0};
+    EXPECT_EQ(parallelFor(executor, 0, count, grain, [&sum](std::size_t i) { sum += i; }), 0);
+    return sum.load();
+}
+
+TEST(ActuatorsTest, Inline) {
+    InlineExecutor   executor;
+    std::vector<int> order;
+    EXPECT_EQ(parallelFor(executor, 0, 10, 3, [&order](std::size_t i) { order.push_back(static_cast<int>(i)); }), 0);
+    EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    EXPECT_EQ(sumOf(executor, 1000, 1), 999LL * 1000 / 2);
+}
+
+TEST(ActuatorsTest, SingleThread) {
+    std::vector<int> order;
+    std::atomic<int> inThread{0};
+    {
+        SingleThreadExecutor executor("single", 128);
+        EXPECT_FALSE(executor.runningInThisThread());
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_EQ(executor.execute([i, &order, &inThread, &executor]() {
+                order.push_back(i);
+                inThread += executor.runningInThisThread();
+            }),
+                      0);
+        }
+        EXPECT_EQ(sumOf(executor, 1000, 100), 999LL * 1000 / 2);
+    }
+    // the executor runs what was queued before it is destroyed, in order.
+    ASSERT_EQ(order.size(), 100);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(order[i], i);
+    }
+    EXPECT_EQ(inThread.load(), 100);
+}
+
+TEST(ActuatorsTest, Pool) {
+    ThreadPool threadPool(4);
+    threadPool.start(true);
+    PoolExecutor executor(threadPool);
+    EXPECT_EQ(sumOf(executor, 100000, 1000), 99999LL * 100000 / 2);
+    // nested: the outer chunks wait on their inner loops from worker threads.
+    std::atomic<long long> sum{0};
+    EXPECT_EQ(parallelFor(executor, 0, 64, 1,
+                          [&executor, &sum](std::size_t) {
+                              parallelFor(executor, 0, 100, 10, [&sum](std::size_t i) { sum += i; });
+                          }),
+              0);
+    EXPECT_EQ(sum.load(), 64LL * 99 * 100 / 2);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ActuatorsTest, Strand) {
+    ThreadPool threadPool(4);
+    threadPool.start(true);
+    StrandExecutor   executor(threadPool);
+    std::atomic<int> running{0}, overlaps{0};
+    EXPECT_EQ(parallelFor(executor, 0, 1000, 10,
+                          [&executor, &running, &overlaps](std::size_t) {
+                              // the calling thread runs the last chunk itself, outside the strand.
+                              if (!executor.strand().runningInThisThread()) {
+                                  return;
+                              }
+                              overlaps += running.fetch_add(1) != 0;
+                              running.fetch_sub(1);
+                          }),
+              0);
+    EXPECT_EQ(overlaps.load(), 0);
+    threadPool.stopAndwaitAll();
+}
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,204 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../workflows/channel.hpp"
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/threadpools.hpp"
+
+LLWFLOWS_NS_USING
+
+TEST(ChannelTest, TryOperations) {
+    Channel<std::string> channel(2);
+    std::string          item;
+    EXPECT_EQ(channel.tryReceive(item), ChannelStatus::Empty);
+    EXPECT_EQ(channel.trySend("a"), ChannelStatus::Ok);
+    EXPECT_EQ(channel.trySend(std::string("b")), ChannelStatus::Ok);
+    EXPECT_EQ(channel.trySend("c"), ChannelStatus::Full);
+    EXPECT_EQ(channel.size(), 2);
+
+    channel.close();
+    EXPECT_TRUE(channel.isClosed());
+    EXPECT_EQ(channel.trySend("d"), ChannelStatus::Closed);
+    // what was sent before the close is still delivered.
+    EXPECT_EQ(channel.tryReceive(item), ChannelStatus::Ok);
+    EXPECT_EQ(item, "a");
+    EXPECT_EQ(channel.receive(item), ChannelStatus::Ok);
+    EXPECT_EQ(item, "b");
+    EXPECT_EQ(channel.tryReceive(item), ChannelStatus::Closed);
+    EXPECT_EQ(channel.receive(item), ChannelStatus::Closed);
+    // no shared owner, no asynchronous receive.
+    ThreadPool threadPool(1);
+    EXPECT_EQ(channel.receiveAsync(threadPool, [](std::optional<std::string>) {}), -1);
+}
+
+TEST(ChannelTest, BlockingThreads) {
+    constexpr int            num_producers = 4, num_consumers = 4, num_items = 20000;
+    auto                     channel = Channel<int>::create(16);
+    std::atomic<long long>   sum{0};
+    std::atomic<int>         received{0};
+    std::vector<std::thread> producers, consumers;
+    for (int i = 0; i < num_consumers; ++i) {
+        consumers.emplace_back([&]() {
+            int item = 0;
+            while (channel->receive(item) == ChannelStatus::Ok) {
+                sum += item;
+                ++received;
+            }
+        });
+    }
+    for (int i = 0; i < num_producers; ++i) {
+        producers.emplace_back([&]() {
+            for (int j = 1; j <= num_items; ++j) {
+                EXPECT_EQ(channel->send(j), ChannelStatus::Ok);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    channel->close();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+    EXPECT_EQ(received.load(), num_producers * num_items);
+    EXPECT_EQ(sum.load(), 1LL * num_producers * num_items * (num_items + 1) / 2);
+}
+
+TEST(ChannelTest, CloseWakesReceiver) {
+    auto        channel = Channel<int>::create(4);
+    std::thread receiver([&channel]() {
+        int item = 0;
+        EXPECT_EQ(channel->receive(item), ChannelStatus::Closed);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    channel->close();
+    receiver.join();
+}
+
+TEST(ChannelTest, ReceiveAsync) {
+    constexpr int    num_receivers = 10;
+    ThreadPool       threadPool(1);
+    auto             channel = Channel<int>::create(4);
+    std::atomic<int> sum{0}, closed{0};
+    threadPool.start(true);
+    for (int i = 0; i < num_receivers + 2; ++i) {
+        ASSERT_EQ(channel->receiveAsync(threadPool,
+                                        [&sum, &closed](std::optional<int> item) {
+                                            if (item.has_value()) {
+                                                sum += *item;
+                                            } else {
+                                                ++closed;
+                                            }
+                                        }),
+                  0);
+    }
+    // parked receivers hold no worker, the only worker still runs other tasks.
+    auto promise = threadPool.addTask([]() {});
+    threadPool.wait(promise);
+    EXPECT_EQ(promise->state(), TaskState::Done);
+
+    for (int i = 1; i <= num_receivers; ++i) {
+        EXPECT_EQ(channel->send(i), ChannelStatus::Ok);
+    }
+    channel->close();
+    while (closed.load() < 2) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(sum.load(), num_receivers * (num_receivers + 1) / 2);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ChannelTest, SendAsync) {
+    constexpr int    num_senders = 10;
+    ThreadPool       threadPool(1);
+    auto             channel = Channel<std::unique_ptr<int>>::create(2);
+    std::atomic<int> sent{0}, closed{0};
+    threadPool.start(true);
+    auto onSent = [&sent, &closed](ChannelStatus status) {
+        if (status == ChannelStatus::Ok) {
+            ++sent;
+        } else if (status == ChannelStatus::Closed) {
+            ++closed;
+        }
+    };
+    for (int i = 1; i <= num_senders + 2; ++i) {
+        ASSERT_EQ(channel->sendAsync(threadPool, std::make_unique<int>(i), onSent), 0);
+    }
+    // parked senders hold no worker, the only worker still runs other tasks.
+    auto promise = threadPool.addTask([]() {});
+    EXPECT_EQ(promise->wait(), TaskState::Done);
+    EXPECT_EQ(sent.load(), 2);
+
+    // each receive makes room for one parked sender.
+    int                  sum = 0;
+    std::unique_ptr<int> item;
+    for (int i = 0; i < num_senders; ++i) {
+        EXPECT_EQ(channel->receive(item), ChannelStatus::Ok);
+        sum += *item;
+    }
+    threadPool.waitIdle();
+    EXPECT_EQ(sent.load(), num_senders + 2);
+    channel->close();
+    while (channel->receive(item) == ChannelStatus::Ok) {
+        sum += *item;
+    }
+    EXPECT_EQ(sum, (num_senders + 2) * (num_senders + 3) / 2);
+
+    // the senders parked on a full channel get Closed when it closes.
+    auto full = Channel<int>::create(1);
+    EXPECT_EQ(full->trySend(0), ChannelStatus::Ok);
+    ASSERT_EQ(full->sendAsync(threadPool, 1, onSent), 0);
+    threadPool.waitIdle();
+    full->close();
+    threadPool.waitIdle();
+    EXPECT_EQ(closed.load(), 1);
+
+    // a stopped pool refuses the tasks.
+    threadPool.stopAndwaitAll();
+    EXPECT_EQ(full->sendAsync(threadPool, 2, onSent), -1);
+    EXPECT_EQ(full->receiveAsync(threadPool, [](std::optional<int>) {}), -1);
+}
+
+TEST(ChannelTest, AsyncStage) {
+    constexpr int                           num_items = 10000;
+    ThreadPool                              threadPool(2);
+    auto                                    source = Channel<int>::create(8), sink = Channel<int>::create(8);
+    std::function<void(std::optional<int>)> stage;
+    threadPool.start(true);
+    // a streaming stage receives the next item only after it handled the last one, so it keeps the order.
+    stage = [&](std::optional<int> item) {
+        if (!item.has_value()) {
+            sink->close();
+            return;
+        }
+        sink->send(*item * 2);
+        source->receiveAsync(threadPool, stage);
+    };
+    ASSERT_EQ(source->receiveAsync(threadPool, stage), 0);
+    std::thread producer([&source]() {
+        for (int i = 0; i < num_items; ++i) {
+            source->send(i);
+        }
+        source->close();
+    });
+    int item = 0, count = 0;
+    while (sink->receive(item) == ChannelStatus::Ok) {
+        EXPECT_EQ(item, count * 2);
+        ++count;
+    }
+    producer.join();
+    EXPECT_EQ(count, num_items);
+    threadPool.stopAndwaitAll();
+}
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/executionplan.hpp"
+#include "../../workflows/threadpools.hpp"
+
+LLWFLOWS_NS_USING
+
+static constexpr auto kRunTimeout = std::chrono::seconds(10);
+
+TEST(ExecutionPlanTest, ReplayDiamond) {
+    ThreadPool threadPool(4);
+    threadPool.start(true);
+    int              input = 0;
+    std::atomic<int> left{0}, right{0}, sum{0};
+    std::mutex       mutex;
+    std::vector<int> order;
+    auto             log = [&](int node) {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(node);
+    };
+
+    ASSERT_EQ(threadPool.beginCapture(), 0);
+    EXPECT_EQ(threadPool.beginCapture(), -1);
+    TaskDescription desc;
+    desc.name = "top";
+    auto top  = threadPool.addTask([&]() { log(0); }, desc);
+    desc.name = "left";
+    desc.dependencies.push_back(top);
+    auto l = threadPool.addTask(
+        [&]() {
+            log(1);
+            left = input * 2;
+        },
+        desc);
+    desc.name = "right";
+    auto r    = threadPool.addTask(
+        [&]() {
+            log(2);
+            right = input * 3;
+        },
+        desc);
+    desc.name         = "bottom";
+    desc.dependencies = {l, r};
+    auto bottom       = threadPool.addTask(
+        [&]() {
+            log(3);
+            sum = left + right;
+        },
+        desc);
+    // nothing runs while capturing.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_TRUE(order.empty());
+    auto plan = threadPool.endCapture();
+    ASSERT_NE(plan, nullptr);
+    EXPECT_EQ(threadPool.endCapture(), nullptr);
+    ASSERT_EQ(plan->taskCount(), 4);
+    EXPECT_EQ(plan->promise(3), bottom);
+    EXPECT_EQ(plan->name(1).view(), "left");
+    // the first successor continues on the worker of its predecessor.
+    EXPECT_EQ(plan->workerId(1), plan->workerId(0));
+
+    std::vector<int> workers;
+    for (int i = 0; i < plan->taskCount(); ++i) {
+        workers.push_back(plan->workerId(i));
+    }
+    for (input = 1; input <= 50; ++input) {
+        order.clear();
+        auto run = plan->replay();
+        ASSERT_NE(run, nullptr);
+        ASSERT_EQ(run->waitFor(kRunTimeout), TaskState::Done);
+        EXPECT_EQ(sum.load(), input * 5);
+        ASSERT_EQ(order.size(), 4u);
+        EXPECT_EQ(order.front(), 0);
+        EXPECT_EQ(order.back(), 3);
+    }
+    for (int i = 0; i < plan->taskCount(); ++i) {
+        EXPECT_EQ(plan->workerId(i), workers[i]);
+    }
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ExecutionPlanTest, Chain) {
+    constexpr int num_tasks = 100;
+    ThreadPool    threadPool(2);
+    threadPool.start(true);
+    std::atomic<int> next{0};
+    std::atomic<int> outOfOrder{0};
+
+    ASSERT_EQ(threadPool.beginCapture(), 0);
+    std::shared_ptr<TaskPromise> last;
+    for (int i = 0; i < num_tasks; ++i) {
+        TaskDescription desc;
+        if (last != nullptr) {
+            desc.dependencies.push_back(last);
+        }
+        last = threadPool.addTask(
+            [&, i]() {
+                if (next.fetch_add(1) != i) {
+                    ++outOfOrder;
+                }
+            },
+            std::move(desc));
+    }
+    auto plan = threadPool.endCapture();
+    ASSERT_NE(plan, nullptr);
+    for (int round = 0; round < 20; ++round) {
+        next = 0;
+        auto run = plan->replay();
+        ASSERT_NE(run, nullptr);
+        EXPECT_EQ(run->waitFor(kRunTimeout), TaskState::Done);
+        EXPECT_EQ(next.load(), num_tasks);
+        // the promise of a node is reused by every replay.
+        EXPECT_EQ(plan->promise(num_tasks - 1)->waitFor(kRunTimeout), TaskState::Done);
+        EXPECT_EQ(plan->promise(num_tasks - 1), last);
+    }
+    EXPECT_EQ(outOfOrder.load(), 0);
+    threadPool.waitIdle();
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ExecutionPlanTest, OtherThreadNotCaptured) {
+    ThreadPool threadPool(2);
+    threadPool.start(true);
+    std::atomic<int> captured{0}, direct{0};
+    ASSERT_EQ(threadPool.beginCapture(), 0);
+    threadPool.addTask([&captured]() { ++captured; });
+    std::thread other([&]() {
+        auto promise = threadPool.addTask([&direct]() { ++direct; });
+        promise->waitFor(kRunTimeout);
+    });
+    other.join();
+    EXPECT_EQ(direct.load(), 1);
+    auto plan = threadPool.endCapture();
+    ASSERT_NE(plan, nullptr);
+    EXPECT_EQ(plan->taskCount(), 1);
+    EXPECT_EQ(captured.load(), 0);
+    EXPECT_EQ(plan->replay()->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(captured.load(), 1);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ExecutionPlanTest, Cancel) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    std::atomic<bool> release{false};
+    std::atomic<int>  ran{0};
+    ASSERT_EQ(threadPool.beginCapture(), 0);
+    auto first = threadPool.addTask([&]() {
+        ++ran;
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    TaskDescription desc;
+    desc.dependencies.push_back(first);
+    threadPool.addTask([&ran]() { ++ran; }, desc);
+    auto plan = threadPool.endCapture();
+    ASSERT_NE(plan, nullptr);
+    auto run = plan->replay();
+    ASSERT_NE(run, nullptr);
+    EXPECT_EQ(plan->replay(), nullptr);
+    while (ran.load() == 0) {
+        std::this_thread::yield();
+    }
+    run->requestCancel();
+    release = true;
+    EXPECT_EQ(run->waitFor(kRunTimeout), TaskState::Cancelled);
+    EXPECT_EQ(ran.load(), 1);
+    // a cancelled run does not prevent the next one.
+    EXPECT_EQ(plan->replay()->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(ran.load(), 3);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ExecutionPlanTest, CancelNode) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    std::atomic<int> ran{0};
+    ASSERT_EQ(threadPool.beginCapture(), 0);
+    auto a = threadPool.addTask([&ran]() { ++ran; });
+    TaskDescription desc;
+    desc.dependencies.push_back(a);
+    auto b = threadPool.addTask([&ran]() { ++ran; }, desc);
+    auto plan = threadPool.endCapture();
+    ASSERT_NE(plan, nullptr);
+    // the only worker is busy, so the first node is still queued when it is cancelled.
+    std::atomic<bool> release{false};
+    auto              blocker = threadPool.addTask([&release]() {
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    auto run = plan->replay();
+    ASSERT_NE(run, nullptr);
+    EXPECT_EQ(threadPool.cancel(a), 0);
+    release = true;
+    threadPool.waitIdle();
+    EXPECT_EQ(blocker->state(), TaskState::Done);
+    EXPECT_EQ(run->state(), TaskState::Cancelled);
+    EXPECT_EQ(a->state(), TaskState::Cancelled);
+    EXPECT_EQ(b->state(), TaskState::Cancelled);
+    EXPECT_EQ(ran.load(), 0);
+    EXPECT_EQ(plan->replay()->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(ran.load(), 2);
+
+    // the nodes dropped by a stop finish the replay too.
+    release = false;
+    threadPool.addTask([&release]() {
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    run = plan->replay();
+    ASSERT_NE(run, nullptr);
+    std::thread releaser([&release]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        release = true;
+    });
+    threadPool.stop();
+    releaser.join();
+    EXPECT_EQ(run->state(), TaskState::Cancelled);
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+    EXPECT_EQ(ran.load(), 2);
+}
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -2,8 +2,10 @@
 
 #include <bitset>
 #include <chrono>
+#include <ctime>
 #include <thread>
 #include <random>
+#include <set>
 
 #include "../../workflows/detail/log.hpp"
 #include "../../workflows/threadpools.hpp"
@@ -212,6 +214,531 @@ TEST(ThreadPoolTest, priority) {
     EXPECT_GE(counts[2], counts[1]);
 };
 
+TEST(ThreadPoolTest, priorityAging) {
+    constexpr int num_high_tasks = 100;
+    ThreadPool    threadPool(1);
+    threadPool.start();
+    EXPECT_EQ(threadPool.priorityAging(), ThreadWorker::kDefaultAgingInterval);
+    for (auto interval : {std::chrono::milliseconds(0), std::chrono::milliseconds(5)}) {
+        threadPool.setPriorityAging(interval);
+        std::atomic<bool> release{false};
+        std::atomic<int>  highDone{0};
+        int               highDoneBeforeLow = -1;
+        // hold the worker until both lanes are filled.
+        threadPool.addTask([&release]() {
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+        TaskDescription high;
+        high.priority = TaskPriority::High;
+        for (int i = 0; i < num_high_tasks; ++i) {
+            threadPool.addTask(
+                [&highDone]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    ++highDone;
+                },
+                high);
+        }
+        TaskDescription low;
+        low.priority = TaskPriority::Low;
+        threadPool.addTask([&]() { highDoneBeforeLow = highDone.load(); }, low);
+        release = true;
+        threadPool.waitIdle();
+        if (interval.count() == 0) {
+            EXPECT_EQ(highDoneBeforeLow, num_high_tasks);
+        } else {
+            // the low task aged past the high lane instead of waiting for all of it.
+            EXPECT_LT(highDoneBeforeLow, num_high_tasks / 2);
+        }
+    }
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ThreadPoolTest, delayedTask) {
+    using Clock = ThreadPool::Clock;
+    // one worker: tasks due in the same timer tick are distributed together, several workers may finish them in any
+    // order, and the first timer tick waits for the timer thread to start.
+    constexpr int                num_test_threads = 1, num_test_tasks = 50;
+    SRingBuffer<int>             doneIds(num_test_tasks + 1);
+    ThreadPool                   threadPool(num_test_threads);
+    std::shared_ptr<TaskPromise> taskInfo[num_test_tasks];
+    threadPool.start();
+
+    auto tStart = Clock::now();
+    for (int i = 0; i < num_test_tasks; ++i) {
+        auto delay  = std::chrono::milliseconds((num_test_tasks - i) * 4);
+        taskInfo[i] = threadPool.addTaskAfter(delay, [i, delay, tStart, &doneIds]() {
+            EXPECT_GE(Clock::now() - tStart, delay);
+            doneIds.push(i);
+        });
+        ASSERT_TRUE(taskInfo[i] != nullptr);
+    }
+    EXPECT_EQ(taskInfo[0]->cancel(), 0);
+    for (int i = 1; i < num_test_tasks; ++i) {
+        threadPool.wait(taskInfo[i]);
+        EXPECT_EQ(taskInfo[i]->state(), TaskState::Done);
+    }
+    threadPool.stop();
+    EXPECT_EQ(taskInfo[0]->state(), TaskState::Cancelled);
+
+    // the later added tasks are due earlier.
+    std::vector<int> order;
+    int              id;
+    while (doneIds.pop(id)) {
+        order.push_back(id);
+    }
+    ASSERT_EQ(order.size(), num_test_tasks - 1);
+    EXPECT_EQ(order.front(), num_test_tasks - 1);
+    EXPECT_EQ(order.back(), 1);
+}
+
+TEST(ThreadPoolTest, periodicTask) {
+    ThreadPool       threadPool(2);
+    std::atomic<int> count{0};
+    threadPool.start();
+
+    auto task = threadPool.addPeriodicTask(std::chrono::milliseconds(10), [&count]() { ++count; });
+    ASSERT_TRUE(task != nullptr);
+    std::this_thread::sleep_for(std::chrono::milliseconds(205));
+    EXPECT_EQ(threadPool.cancel(task), 0);
+    threadPool.wait(task);
+    auto countAfterCancel = count.load();
+    LLWFLOWS_LOG_INFO("periodic task run {} times in 205 ms", countAfterCancel);
+    EXPECT_GE(countAfterCancel, 5);
+    EXPECT_LE(countAfterCancel, 21);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_LE(count.load(), countAfterCancel + 1);
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, cancelRunningTask) {
+    ThreadPool        threadPool(2);
+    std::atomic<bool> started{false};
+    std::atomic<bool> stopped{false};
+    threadPool.start();
+
+    auto task = threadPool.addTask([&started, &stopped]() {
+        auto token = ThreadWorker::currentCancellationToken();
+        started    = true;
+        while (!token.isCancelled()) {
+            std::this_thread::yield();
+        }
+        stopped = true;
+    });
+    ASSERT_TRUE(task != nullptr);
+    while (!started) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(task->cancel(), -1);
+    EXPECT_EQ(threadPool.cancelSubgraph(task), 1);
+    threadPool.wait(task);
+    EXPECT_TRUE(stopped);
+    EXPECT_EQ(task->state(), TaskState::Cancelled);
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, cancelSubgraph) {
+    constexpr int                num_test_tasks = 100;
+    ThreadPool                   threadPool(4);
+    std::atomic<bool>            started{false};
+    std::atomic<int>             count{0};
+    std::shared_ptr<TaskPromise> taskInfo[num_test_tasks];
+    threadPool.start();
+
+    taskInfo[0] = threadPool.addTask([&started]() {
+        started    = true;
+        auto token = ThreadWorker::currentCancellationToken();
+        while (!token.isCancelled()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    // a chain and a fan out hanging on the root.
+    for (int i = 1; i < num_test_tasks; ++i) {
+        TaskDescription desc;
+        desc.dependencies.push_back(taskInfo[i % 2 == 0 ? i - 1 : 0]);
+        taskInfo[i] = threadPool.addTask([&count]() { ++count; }, desc);
+        ASSERT_TRUE(taskInfo[i] != nullptr);
+    }
+    while (!started) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(threadPool.cancelSubgraph(taskInfo[0]), num_test_tasks);
+    EXPECT_EQ(threadPool.cancelSubgraph(taskInfo[0]), 0);
+    for (int i = 0; i < num_test_tasks; ++i) {
+        threadPool.wait(taskInfo[i]);
+        EXPECT_EQ(taskInfo[i]->state(), TaskState::Cancelled);
+    }
+    EXPECT_EQ(count.load(), 0);
+
+    // depends on a cancelled task is cancelled at once.
+    TaskDescription desc;
+    desc.dependencies.push_back(taskInfo[0]);
+    auto task = threadPool.addTask([&count]() { ++count; }, desc);
+    ASSERT_TRUE(task != nullptr);
+    EXPECT_EQ(task->state(), TaskState::Cancelled);
+    threadPool.stopAndwaitAll();
+    EXPECT_EQ(count.load(), 0);
+}
+
+TEST(ThreadPoolTest, waitIdle) {
+    constexpr int                num_test_threads = 8, num_test_tasks = 200;
+    ThreadPool                   threadPool(num_test_threads);
+    std::atomic<int>             count{0};
+    std::shared_ptr<TaskPromise> taskInfo[num_test_tasks];
+    threadPool.start(true);
+
+    // dependencies on later tasks make the first ones retry until the tail is done.
+    taskInfo[num_test_tasks - 1] = threadPool.addTask([&count]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ++count;
+    });
+    for (int i = 0; i < num_test_tasks - 1; ++i) {
+        TaskDescription desc;
+        desc.dependencies.push_back(taskInfo[num_test_tasks - 1]);
+        taskInfo[i] = threadPool.addTask([&count]() { ++count; }, desc);
+        ASSERT_TRUE(taskInfo[i] != nullptr);
+    }
+    threadPool.waitIdle();
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+    EXPECT_EQ(count.load(), num_test_tasks);
+    for (int i = 0; i < num_test_tasks; ++i) {
+        EXPECT_EQ(taskInfo[i]->state(), TaskState::Done);
+    }
+
+    // idle pool returns at once and can be reused.
+    threadPool.waitIdle();
+    threadPool.addTask([&count]() { ++count; });
+    threadPool.stopAndwaitAll();
+    EXPECT_EQ(count.load(), num_test_tasks + 1);
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+}
+
+TEST(ThreadPoolTest, stopAndwaitAllWithRetry) {
+    constexpr int                num_test_threads = 10, num_test_tasks = 100;
+    ThreadPool                   threadPool(num_test_threads);
+    std::atomic<int>             count{0};
+    std::shared_ptr<TaskPromise> taskInfo[num_test_tasks];
+    threadPool.start();
+    for (int i = 0; i < num_test_tasks; ++i) {
+        TaskDescription desc;
+        if (i > 0) {
+            desc.dependencies.push_back(taskInfo[i - 1]);
+        }
+        taskInfo[i] = threadPool.addTask([&count]() { ++count; }, desc);
+        ASSERT_TRUE(taskInfo[i] != nullptr);
+    }
+    auto tStart = std::chrono::steady_clock::now();
+    threadPool.stopAndwaitAll();
+    LLWFLOWS_LOG_INFO("stop and wait all take {} ms", std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                          std::chrono::steady_clock::now() - tStart)
+                                                          .count());
+    EXPECT_EQ(count.load(), num_test_tasks);
+    for (int i = 0; i < num_test_tasks; ++i) {
+        EXPECT_EQ(taskInfo[i]->state(), TaskState::Done);
+    }
+}
+
+TEST(ThreadPoolTest, localSpawn) {
+    constexpr int    num_test_threads = 4, depth = 10;
+    ThreadPool       threadPool(num_test_threads);
+    std::atomic<int> leaves{0};
+    threadPool.start(true);
+
+    // a child added from a task is queued on the worker of its parent.
+    std::shared_ptr<TaskPromise> child;
+    int                          parentWorkerId = -1;
+    auto                         parent         = threadPool.addTask([&]() {
+        parentWorkerId = ThreadWorker::currentWorker()->workerId();
+        child          = threadPool.addTask([]() {});
+    });
+    threadPool.waitIdle();
+    ASSERT_EQ(parent->state(), TaskState::Done);
+    ASSERT_TRUE(child != nullptr);
+    EXPECT_EQ(child->state(), TaskState::Done);
+    EXPECT_EQ(child->firstWorkerId(), parentWorkerId);
+
+    // divide and conquer, idle workers steal the spawned halves.
+    std::function<void(int)> split = [&](int level) {
+        if (level == 0) {
+            ++leaves;
+            return;
+        }
+        threadPool.addTask([&split, level]() { split(level - 1); });
+        threadPool.addTask([&split, level]() { split(level - 1); });
+    };
+    threadPool.addTask([&split]() { split(depth); });
+    threadPool.waitIdle();
+    EXPECT_EQ(leaves.load(), 1 << depth);
+    threadPool.stopAndwaitAll();
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+}
+
+TEST(ThreadPoolTest, affinity) {
+    constexpr int                num_test_threads = 4, num_keys = 16, num_rounds = 8;
+    ThreadPool                   threadPool(num_test_threads);
+    std::shared_ptr<TaskPromise> taskInfo[num_keys][num_rounds];
+    threadPool.start();
+
+    // tasks touching the same shard are queued on the same worker.
+    for (int round = 0; round < num_rounds; ++round) {
+        for (int key = 0; key < num_keys; ++key) {
+            TaskDescription desc;
+            desc.affinityKey     = key + 1;
+            taskInfo[key][round] = threadPool.addTask([]() {}, desc);
+            ASSERT_TRUE(taskInfo[key][round] != nullptr);
+        }
+    }
+    threadPool.waitIdle();
+    std::set<int> usedWorkers;
+    for (int key = 0; key < num_keys; ++key) {
+        for (int round = 0; round < num_rounds; ++round) {
+            EXPECT_EQ(taskInfo[key][round]->state(), TaskState::Done);
+            EXPECT_EQ(taskInfo[key][round]->firstWorkerId(), taskInfo[key][0]->firstWorkerId());
+        }
+        usedWorkers.insert(taskInfo[key][0]->firstWorkerId());
+    }
+    EXPECT_GT(usedWorkers.size(), 1);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ThreadPoolTest, nestedWait) {
+    constexpr int num_test_threads = 2, n = 16;
+    ThreadPool    threadPool(num_test_threads);
+    threadPool.start(true);
+
+    // fork-join deeper than the worker count, every level blocks a worker in wait without helping.
+    std::function<int(int)> fib = [&](int i) -> int {
+        if (i < 2) {
+            return i;
+        }
+        int  a = 0, b = 0;
+        auto left  = threadPool.addTask([&]() { a = fib(i - 1); });
+        auto right = threadPool.addTask([&]() { b = fib(i - 2); });
+        threadPool.wait(left);
+        right->wait();
+        return a + b;
+    };
+    int  result = 0;
+    auto root   = threadPool.addTask([&]() { result = fib(n); });
+    threadPool.wait(root);
+    EXPECT_EQ(root->state(), TaskState::Done);
+    EXPECT_EQ(result, 987);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ThreadPoolTest, nestedWaitBlocks) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    // the only worker waits on a latch released from outside the pool, it must sleep and still run new tasks.
+    auto              gate = TaskLatch::create(1);
+    std::atomic<bool> ran{false};
+    std::clock_t      cpu = 0;
+    auto              waiter = threadPool.addTask([&gate, &ran, &cpu]() {
+        auto cpuStart = std::clock();
+        gate->wait();
+        cpu = std::clock() - cpuStart;
+        EXPECT_TRUE(ran.load());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto posted = threadPool.addTask([&ran]() { ran = true; });
+    auto tStart = std::chrono::steady_clock::now();
+    while (!ran.load() && std::chrono::steady_clock::now() - tStart < std::chrono::seconds(1)) {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(ran.load());
+    EXPECT_LT(std::chrono::steady_clock::now() - tStart, std::chrono::milliseconds(100));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    gate->countDown();
+    EXPECT_EQ(waiter->wait(), TaskState::Done);
+    EXPECT_EQ(posted->state(), TaskState::Done);
+    // 250ms of waiting, a spinning worker would burn all of it.
+    EXPECT_LT(cpu, CLOCKS_PER_SEC / 10);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ThreadPoolTest, waitTimeout) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    std::atomic<bool> release{false};
+    auto              task = threadPool.addTask([&release]() {
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    auto tStart = std::chrono::steady_clock::now();
+    auto state  = task->waitFor(std::chrono::milliseconds(20));
+    EXPECT_TRUE(state == TaskState::Queuing || state == TaskState::Running);
+    EXPECT_GE(std::chrono::steady_clock::now() - tStart, std::chrono::milliseconds(20));
+    EXPECT_EQ(task->waiterCount(), 0);
+    state = task->waitUntil(std::chrono::steady_clock::now() - std::chrono::seconds(1));
+    EXPECT_TRUE(state == TaskState::Queuing || state == TaskState::Running);
+
+    // a blocked waiter is counted, and woken by the completion.
+    std::atomic<TaskState> waited{TaskState::Queuing};
+    std::thread            waiter([&task, &waited]() { waited = task->wait(); });
+    while (task->waiterCount() == 0) {
+        std::this_thread::yield();
+    }
+    release = true;
+    waiter.join();
+    EXPECT_EQ(waited.load(), TaskState::Done);
+    EXPECT_EQ(task->waiterCount(), 0);
+    EXPECT_EQ(task->waitFor(std::chrono::seconds(1)), TaskState::Done);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ThreadPoolTest, latch) {
+    constexpr int num_test_threads = 4, num_test_tasks = 2000;
+    ThreadPool    threadPool(num_test_threads);
+    threadPool.start(true);
+    std::atomic<int> count{0};
+    std::atomic<int> seen{-1};
+    auto             latch = TaskLatch::create(num_test_tasks);
+    // the fan-in task depends on the latch only, added before its inputs so it waits on the latch.
+    TaskDescription joinDesc;
+    joinDesc.dependencies.push_back(latch);
+    auto join = threadPool.addTask([&count, &seen]() { seen = count.load(); }, joinDesc);
+    TaskDescription desc;
+    desc.latch = latch;
+    for (int i = 0; i < num_test_tasks; ++i) {
+        ASSERT_TRUE(threadPool.addTask([&count]() { ++count; }, desc) != nullptr);
+    }
+    threadPool.wait(latch);
+    EXPECT_EQ(latch->state(), TaskState::Done);
+    EXPECT_EQ(latch->count(), 0);
+    EXPECT_EQ(count.load(), num_test_tasks);
+    EXPECT_EQ(latch->add(), -1);
+    threadPool.wait(join);
+    EXPECT_EQ(seen.load(), num_test_tasks);
+
+    // cancelled tasks count down too, and an empty latch is done at once.
+    auto grow = TaskLatch::create(1);
+    EXPECT_EQ(grow->add(2), 0);
+    EXPECT_EQ(grow->countDown(2), 1);
+    EXPECT_EQ(grow->state(), TaskState::Running);
+    desc.latch        = grow;
+    auto blocker      = std::make_shared<TaskPromise>();
+    desc.dependencies = {blocker};
+    blocker->requestCancel();
+    auto cancelled = threadPool.addTask([]() {}, desc);
+    EXPECT_EQ(grow->wait(), TaskState::Done);
+    EXPECT_EQ(cancelled->state(), TaskState::Cancelled);
+    EXPECT_EQ(TaskLatch::create(0)->state(), TaskState::Done);
+
+    std::vector<std::shared_ptr<TaskPromise>> tasks;
+    for (int i = 0; i < 100; ++i) {
+        tasks.push_back(threadPool.addTask([&count]() { ++count; }));
+    }
+    threadPool.waitAll(tasks);
+    for (auto& task : tasks) {
+        EXPECT_EQ(task->state(), TaskState::Done);
+    }
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ThreadPoolTest, finishedDependentsUnregistered) {
+    constexpr int num_test_tasks = 1000;
+    ThreadPool    threadPool(4);
+    threadPool.start(true);
+    // a long-lived dependency does not keep the tasks which finished after it.
+    auto config = threadPool.addTask([]() {});
+    EXPECT_EQ(config->wait(), TaskState::Done);
+    auto             arena = std::make_shared<TaskArena>();
+    std::atomic<int> count{0};
+    for (int i = 0; i < num_test_tasks; ++i) {
+        TaskDescription desc;
+        desc.dependencies.push_back(config);
+        desc.arena = i % 2 == 0 ? arena : nullptr;
+        threadPool.addTask([&count]() { ++count; }, std::move(desc));
+    }
+    threadPool.waitIdle();
+    EXPECT_EQ(count.load(), num_test_tasks);
+    EXPECT_EQ(config->dependentCount(), 0u);
+    std::weak_ptr<TaskArena> weakArena = arena;
+    arena.reset();
+    EXPECT_TRUE(weakArena.expired());
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ThreadPoolTest, latchParksDependents) {
+    ThreadPool threadPool(2);
+    threadPool.start(true);
+    // a latch never runs on a worker, its dependent waits on it instead of being retried across the pool.
+    auto            latch = TaskLatch::create(1);
+    TaskDescription desc;
+    desc.dependencies.push_back(latch);
+    std::atomic<bool> ran{false};
+    auto              task   = threadPool.addTask([&ran]() { ran = true; }, desc);
+    auto              tStart = std::chrono::steady_clock::now();
+    while (latch->parkedCount() == 0 && std::chrono::steady_clock::now() - tStart < std::chrono::seconds(1)) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(latch->parkedCount(), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(task->placementCount(), 1);
+    EXPECT_FALSE(ran.load());
+    latch->countDown();
+    EXPECT_EQ(task->wait(), TaskState::Done);
+    EXPECT_EQ(task->placementCount(), 2);
+    EXPECT_EQ(latch->parkedCount(), 0);
+
+    // a task parked on a latch which is never done is cancelled when the pool stops.
+    auto pending = TaskLatch::create(1);
+    desc.dependencies = {pending};
+    auto parked       = threadPool.addTask([]() {}, desc);
+    tStart            = std::chrono::steady_clock::now();
+    while (pending->parkedCount() == 0 && std::chrono::steady_clock::now() - tStart < std::chrono::seconds(1)) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(pending->parkedCount(), 1);
+    threadPool.stop();
+    EXPECT_EQ(parked->state(), TaskState::Cancelled);
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+}
+
+TEST(ThreadPoolTest, taskName) {
+    TaskName empty;
+    TaskName name("stage-a");
+    TaskName same(std::string("stage-") + "a");
+    TaskName other = "stage-b";
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(empty.id(), 0);
+    EXPECT_EQ(name, same);
+    EXPECT_EQ(name.view().data(), same.view().data());
+    EXPECT_NE(name, other);
+    EXPECT_EQ(name.view(), "stage-a");
+    EXPECT_EQ(TaskName::fromId(other.id()).view(), "stage-b");
+
+    // names interned in other threads get the same id.
+    uint32_t id = 0;
+    std::thread([&id]() { id = TaskName("stage-a").id(); }).join();
+    EXPECT_EQ(id, name.id());
+}
+
+TEST(ThreadPoolTest, moveDescription) {
+    constexpr int    num_test_threads = 2;
+    ThreadPool       threadPool(num_test_threads);
+    std::atomic<int> count{0};
+    threadPool.start();
+
+    auto first = threadPool.addTask([&count]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ++count;
+    });
+    TaskDescription desc;
+    desc.name         = "moved";
+    desc.dependencies = {first};
+    auto second       = threadPool.addTask([&count]() { ++count; }, std::move(desc));
+    ASSERT_TRUE(second != nullptr);
+    threadPool.wait(second);
+    EXPECT_EQ(second->state(), TaskState::Done);
+    EXPECT_EQ(count.load(), 2);
+    // the dependency of the moved description was only held by the pool.
+    threadPool.stopAndwaitAll();
+    EXPECT_EQ(first.use_count(), 1);
+}
+
 int main(int argc, char** argv) {
     Thread::makeMetaObjectForCurrentThread("main");
     ::testing::InitGoogleTest(&argc, argv);
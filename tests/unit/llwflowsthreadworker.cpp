@@ -75,6 +75,36 @@ TEST(ThreadWorkerTest, Cancel) {
     EXPECT_EQ(tasks.count(), num_test_threads);
 }
 
+TEST(ThreadWorkerTest, WorkerHistory) {
+    constexpr int num_test_threads = 3;
+    ThreadWorker  threads[num_test_threads];
+    for (int i = 0; i < num_test_threads; ++i) {
+        threads[i].init(i);
+        threads[i].start();
+    }
+    auto promise = std::make_shared<TaskPromise>();
+    EXPECT_EQ(promise->lastWorkerId(), -1);
+    EXPECT_EQ(promise->workerHistory()[0], -1);
+    // the same promise queued again, like a retried task, the run is only done once.
+    const int placements[] = {0, 0, 1, 2, 1, 1};
+    for (auto workerId : placements) {
+        ASSERT_EQ(threads[workerId].post([]() {}, promise), 0);
+    }
+    EXPECT_EQ(promise->placementCount(), 6u);
+    EXPECT_EQ(promise->migrationCount(), 3u);
+    EXPECT_EQ(promise->firstWorkerId(), 0);
+    EXPECT_EQ(promise->lastWorkerId(), 1);
+    auto history = promise->workerHistory();
+    static_assert(TaskPromise::kWorkerHistorySize == 4, "placements below assume 4 entries");
+    EXPECT_EQ(history[0], 1);
+    EXPECT_EQ(history[1], 1);
+    EXPECT_EQ(history[2], 2);
+    EXPECT_EQ(history[3], 1);
+    for (int i = 0; i < num_test_threads; ++i) threads[i].exit(true);
+    for (int i = 0; i < num_test_threads; ++i) threads[i].waitForExit();
+    EXPECT_EQ(promise->state(), TaskState::Done);
+}
+
 int main(int argc, char** argv) {
     Thread::makeMetaObjectForCurrentThread("main");
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../workflows/actuators.hpp"
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/pipeline.hpp"
+#include "../../workflows/threadpools.hpp"
+
+LLWFLOWS_NS_USING
+
+static constexpr auto kRunTimeout = std::chrono::seconds(10);
+
+struct Record {
+    int         input{0};
+    long long   square{0};
+    std::string text;
+};
+
+TEST(PipelineTest, InOrder) {
+    constexpr int          num_items = 20000, num_tokens = 8;
+    ThreadPool             threadPool(4);
+    int                    next = 0;
+    std::atomic<int>       inFlight{0}, maxInFlight{0};
+    std::vector<int>       output;
+    Pipeline<Record>       pipeline([&](Record& record) {
+        if (next == num_items) {
+            return false;
+        }
+        record.input = next++;
+        auto count   = ++inFlight;
+        for (auto max = maxInFlight.load(); count > max && !maxInFlight.compare_exchange_weak(max, count);) {
+        }
+        return true;
+    });
+    threadPool.start(true);
+    pipeline.addStage(StageMode::Parallel, [](Record& record) { record.square = 1LL * record.input * record.input; })
+        .addStage(StageMode::Parallel, [](Record& record) { record.text = std::to_string(record.square); })
+        .addStage(StageMode::SerialInOrder, [&](Record& record) {
+            EXPECT_EQ(record.text, std::to_string(1LL * record.input * record.input));
+            output.push_back(record.input);
+            --inFlight;
+        });
+    EXPECT_EQ(pipeline.stageCount(), 3);
+    EXPECT_TRUE(pipeline.run(threadPool, 0) == nullptr);
+
+    auto promise = pipeline.run(threadPool, num_tokens);
+    ASSERT_TRUE(promise != nullptr);
+    EXPECT_TRUE(pipeline.run(threadPool, num_tokens) == nullptr);
+    EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Done);
+    ASSERT_EQ(output.size(), num_items);
+    for (int i = 0; i < num_items; ++i) {
+        ASSERT_EQ(output[i], i);
+    }
+    EXPECT_LE(maxInFlight.load(), num_tokens);
+
+    // a second run reuses the items.
+    next = num_items - 10;
+    output.clear();
+    EXPECT_EQ(pipeline.run(threadPool, num_tokens)->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(output.size(), 10);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(PipelineTest, OutOfOrder) {
+    constexpr int    num_items = 10000;
+    ThreadPool       threadPool(4);
+    std::atomic<int> running{0}, overlaps{0}, seen{0};
+    int              next = 0;
+    long long        sum  = 0;
+    Pipeline<Record> pipeline([&](Record& record) {
+        record.input = next++;
+        return record.input < num_items;
+    });
+    threadPool.start(true);
+    pipeline.addStage(StageMode::Parallel, [](Record& record) { record.square = record.input; })
+        .addStage(StageMode::SerialOutOfOrder, [&](Record& record) {
+            overlaps += running.fetch_add(1) != 0;
+            sum += record.square;
+            ++seen;
+            running.fetch_sub(1);
+        });
+    EXPECT_EQ(pipeline.run(threadPool, 16)->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(seen.load(), num_items);
+    EXPECT_EQ(overlaps.load(), 0);
+    EXPECT_EQ(sum, 1LL * (num_items - 1) * num_items / 2);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(PipelineTest, EmptyAndCancel) {
+    ThreadPool threadPool(2);
+    threadPool.start(true);
+    Pipeline<int> empty([](int&) { return false; });
+    EXPECT_EQ(empty.run(threadPool, 4)->waitFor(kRunTimeout), TaskState::Done);
+
+    // an endless source, only the cancel stops it.
+    std::atomic<int> count{0};
+    Pipeline<int>    endless([](int& item) {
+        item = 1;
+        return true;
+    });
+    endless.addStage(StageMode::Parallel, [&count](int& item) {
+        count += item;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    });
+    auto promise = endless.run(threadPool, 4);
+    ASSERT_TRUE(promise != nullptr);
+    while (count.load() < 100) {
+        std::this_thread::yield();
+    }
+    promise->requestCancel();
+    EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Cancelled);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(PipelineTest, Executors) {
+    constexpr int num_items = 1000, num_tokens = 4;
+    ThreadPool    threadPool(4);
+    threadPool.start(true);
+    int              next = 0;
+    std::atomic<int> active{0}, maxActive{0}, elsewhere{0};
+    std::vector<int> output;
+    Pipeline<Record> pipeline([&](Record& record) {
+        if (next == num_items) {
+            return false;
+        }
+        record.input = next++;
+        return true;
+    });
+    // on a strand even the parallel stage runs one item at a time.
+    pipeline
+        .addStage(StageMode::Parallel,
+                  [&](Record& record) {
+                      auto count = ++active;
+                      for (auto max = maxActive.load(); count > max && !maxActive.compare_exchange_weak(max, count);) {
+                      }
+                      record.square = 1LL * record.input * record.input;
+                      --active;
+                  })
+        .addStage(StageMode::SerialInOrder, [&](Record& record) { output.push_back(record.input); });
+    StrandExecutor strand(threadPool);
+    EXPECT_EQ(pipeline.run(strand, num_tokens)->waitFor(kRunTimeout), TaskState::Done);
+    ASSERT_EQ(output.size(), num_items);
+    for (int i = 0; i < num_items; ++i) {
+        ASSERT_EQ(output[i], i);
+    }
+    EXPECT_EQ(maxActive.load(), 1);
+
+    SingleThreadExecutor single("pipeline");
+    next = 0;
+    output.clear();
+    pipeline.addStage(StageMode::Parallel, [&](Record&) { elsewhere += single.runningInThisThread() ? 0 : 1; });
+    EXPECT_EQ(pipeline.run(single, num_tokens)->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(output.size(), num_items);
+    EXPECT_EQ(elsewhere.load(), 0);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(PipelineTest, InlineLargeInput) {
+    // every item runs in the calling thread, it must not nest a frame per item.
+    constexpr int    num_items = 200000;
+    int              next      = 0;
+    long long        sum       = 0;
+    Pipeline<Record> pipeline([&next](Record& record) {
+        record.input = next++;
+        return record.input < num_items;
+    });
+    pipeline.addStage(StageMode::Parallel, [](Record& record) { record.square = record.input; })
+        .addStage(StageMode::SerialInOrder, [&sum](Record& record) { sum += record.square; });
+    InlineExecutor executor;
+    auto           promise = pipeline.run(executor, 4);
+    ASSERT_TRUE(promise != nullptr);
+    EXPECT_EQ(promise->state(), TaskState::Done);
+    EXPECT_EQ(sum, 1LL * (num_items - 1) * num_items / 2);
+
+    // an executor refusing every task makes the pipeline run it in place as well.
+    struct RefusingExecutor {
+        auto execute(std::function<void()>) -> int { return -1; }
+    } refusing;
+    next    = 0;
+    sum     = 0;
+    promise = pipeline.run(refusing, 4);
+    ASSERT_TRUE(promise != nullptr);
+    EXPECT_EQ(promise->state(), TaskState::Done);
+    EXPECT_EQ(sum, 1LL * (num_items - 1) * num_items / 2);
+}
+
+TEST(PipelineTest, Scaling) {
+    constexpr int num_items = 2000;
+    for (int workers : {1, 4}) {
+        ThreadPool       threadPool(workers);
+        int              next = 0;
+        Pipeline<Record> pipeline([&next](Record& record) {
+            record.input = next++;
+            return record.input < num_items;
+        });
+        threadPool.start(true);
+        pipeline
+            .addStage(StageMode::Parallel,
+                      [](Record& record) {
+                          auto tEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(50);
+                          while (std::chrono::steady_clock::now() < tEnd) {
+                          }
+                          record.square = record.input;
+                      })
+            .addStage(StageMode::SerialInOrder, [](Record&) {});
+        auto tStart = std::chrono::steady_clock::now();
+        EXPECT_EQ(pipeline.run(threadPool, workers * 4)->waitFor(kRunTimeout), TaskState::Done);
+        auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart);
+        LLWFLOWS_LOG_INFO("pipeline of {} items on {} workers: {} us", num_items, workers, cost.count());
+        threadPool.stopAndwaitAll();
+    }
+}
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/profiler.hpp"
+#include "../../workflows/threadpools.hpp"
+
+LLWFLOWS_NS_USING
+
+static auto sleepTask(const int ms) -> std::function<void()> {
+    return [ms]() { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); };
+}
+
+TEST(ProfilerTest, CriticalPath) {
+    ThreadPool threadPool(2);
+    auto       profiler = std::make_shared<Profiler>();
+    threadPool.setProfiler(profiler);
+    threadPool.start(true);
+    // a -> b -> d is longer than a -> c -> d.
+    TaskDescription desc;
+    desc.name = "a";
+    auto a    = threadPool.addTask(sleepTask(2), desc);
+    desc.name = "b";
+    desc.dependencies.push_back(a);
+    auto b    = threadPool.addTask(sleepTask(8), desc);
+    desc.name = "c";
+    auto c    = threadPool.addTask(sleepTask(1), desc);
+    desc.name         = "d";
+    desc.dependencies = {b, c};
+    auto d            = threadPool.addTask(sleepTask(2), desc);
+    threadPool.waitIdle();
+
+    auto report = profiler->analyze();
+    EXPECT_EQ(report.taskCount, 4);
+    ASSERT_EQ(report.criticalPath.size(), 3u);
+    EXPECT_EQ(report.criticalPath[0], a->taskId());
+    EXPECT_EQ(report.criticalPath[1], b->taskId());
+    EXPECT_EQ(report.criticalPath[2], d->taskId());
+    EXPECT_GE(report.criticalPathLength, std::chrono::milliseconds(12));
+    EXPECT_GE(report.totalWork, report.criticalPathLength);
+    EXPECT_GE(report.wallTime, report.criticalPathLength);
+    EXPECT_GT(report.speedup, 0.0);
+    EXPECT_LE(report.speedup, report.idealSpeedup + 0.05);
+    ASSERT_EQ(report.workers.size(), 2u);
+    int taskCount = 0;
+    for (auto& worker : report.workers) {
+        taskCount += worker.taskCount;
+        EXPECT_LE(worker.utilization, 1.0);
+    }
+    EXPECT_EQ(taskCount, 4);
+
+    auto text = profiler->textReport();
+    LLWFLOWS_LOG_INFO("profile:\n{}", text);
+    EXPECT_NE(text.find("critical path:"), std::string::npos);
+    EXPECT_NE(text.find("b#"), std::string::npos);
+    auto dot = profiler->dot();
+    EXPECT_EQ(dot.rfind("digraph", 0), 0u);
+    EXPECT_NE(dot.find("->"), std::string::npos);
+    EXPECT_NE(dot.find("color=red"), std::string::npos);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ProfilerTest, Retry) {
+    ThreadPool threadPool(2);
+    auto       profiler = std::make_shared<Profiler>();
+    threadPool.setProfiler(profiler);
+    threadPool.start(true);
+    // the dependency is only added later, so the dependent retries until then.
+    auto            later = std::make_shared<TaskPromise>();
+    TaskDescription desc;
+    desc.dependencies.push_back(later);
+    threadPool.addTask([]() {}, desc);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    TaskDescription laterDesc;
+    laterDesc.promise = later;
+    threadPool.addTask([]() {}, laterDesc);
+    threadPool.waitIdle();
+
+    auto report = profiler->analyze();
+    EXPECT_EQ(report.taskCount, 2);
+    EXPECT_GT(report.retryCount, 0);
+    EXPECT_GE(report.retryDelay, std::chrono::milliseconds(5));
+
+    // no more records once removed.
+    threadPool.setProfiler(nullptr);
+    threadPool.addTask([]() {});
+    threadPool.waitIdle();
+    EXPECT_EQ(profiler->analyze().taskCount, 2);
+    profiler->clear();
+    EXPECT_EQ(profiler->analyze().taskCount, 0);
+    threadPool.stopAndwaitAll();
+}
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
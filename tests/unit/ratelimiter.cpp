@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/ratelimiter.hpp"
+#include "../../workflows/threadpools.hpp"
+
+LLWFLOWS_NS_USING
+
+static constexpr auto kRunTimeout = std::chrono::seconds(10);
+
+TEST(RateLimiterTest, Bucket) {
+    RateLimiter limiter(1000.0, 5.0);
+    auto        now = RateLimiter::Clock::now();
+    EXPECT_DOUBLE_EQ(limiter.available(now), 5.0);
+    // a full bucket gives the burst at once, then one token per ms.
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(limiter.tryAcquire(now).count(), 0);
+    }
+    EXPECT_DOUBLE_EQ(limiter.available(now), 0.0);
+    auto wait = limiter.tryAcquire(now);
+    EXPECT_EQ(wait, std::chrono::milliseconds(1));
+    EXPECT_EQ(limiter.throttledCount(), 1u);
+    EXPECT_GT(limiter.tryAcquire(now + wait / 2).count(), 0);
+    EXPECT_EQ(limiter.tryAcquire(now + wait).count(), 0);
+    // an idle bucket refills up to the burst only.
+    now += std::chrono::seconds(1);
+    EXPECT_DOUBLE_EQ(limiter.available(now), 5.0);
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(limiter.tryAcquire(now).count(), 0);
+    }
+    EXPECT_GT(limiter.tryAcquire(now).count(), 0);
+
+    RateLimiter unlimited(0.0);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(unlimited.tryAcquire(now).count(), 0);
+    }
+}
+
+TEST(RateLimiterTest, DeferredTasks) {
+    constexpr int num_limited_tasks = 10;
+    constexpr int rate              = 100;
+    ThreadPool    threadPool(1);
+    threadPool.start();
+    auto                                               limiter = RateLimiter::create(rate);
+    std::mutex                                         mutex;
+    std::vector<std::chrono::steady_clock::time_point> starts;
+    TaskDescription                                    desc;
+    desc.rateLimiter = limiter;
+    std::vector<std::shared_ptr<TaskPromise>> promises;
+    for (int i = 0; i < num_limited_tasks; ++i) {
+        promises.push_back(threadPool.addTask(
+            [&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                starts.push_back(std::chrono::steady_clock::now());
+            },
+            desc));
+    }
+    // the single worker is not held by the throttled tasks, other work passes them.
+    std::chrono::steady_clock::time_point otherDone;
+    auto other = threadPool.addTask([&otherDone]() { otherDone = std::chrono::steady_clock::now(); });
+    ASSERT_EQ(other->waitFor(kRunTimeout), TaskState::Done);
+    threadPool.waitIdle();
+    for (auto& promise : promises) {
+        EXPECT_EQ(promise->state(), TaskState::Done);
+    }
+    ASSERT_EQ(starts.size(), static_cast<std::size_t>(num_limited_tasks));
+    std::sort(starts.begin(), starts.end());
+    EXPECT_LT(otherDone, starts.back());
+    // one token every 10ms after the first, less the delay from taking a token to the start.
+    EXPECT_GE(starts.back() - starts.front(),
+              std::chrono::milliseconds(1000 / rate * (num_limited_tasks - 1)) - std::chrono::milliseconds(2));
+    EXPECT_GT(limiter->throttledCount(), 0u);
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(RateLimiterTest, StopAndWaitAll) {
+    constexpr int num_limited_tasks = 5;
+    ThreadPool    threadPool(2);
+    threadPool.start(true);
+    TaskDescription desc;
+    desc.rateLimiter = RateLimiter::create(200);
+    std::atomic<int>                          ran{0};
+    std::vector<std::shared_ptr<TaskPromise>> promises;
+    for (int i = 0; i < num_limited_tasks; ++i) {
+        promises.push_back(threadPool.addTask([&ran]() { ++ran; }, desc));
+    }
+    // the tasks over the bucket are throttled in the timer, they still run before the pool stops.
+    threadPool.stopAndwaitAll();
+    EXPECT_EQ(ran.load(), num_limited_tasks);
+    for (auto& promise : promises) {
+        EXPECT_EQ(promise->state(), TaskState::Done);
+    }
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+}
+
+TEST(RateLimiterTest, Cancel) {
+    ThreadPool threadPool(2);
+    threadPool.start(true);
+    TaskDescription desc;
+    desc.rateLimiter = RateLimiter::create(1.0);
+    std::atomic<int> ran{0};
+    auto             first = threadPool.addTask([&ran]() { ++ran; }, desc);
+    ASSERT_EQ(first->waitFor(kRunTimeout), TaskState::Done);
+    // the next token is a second away, the task waits in the timer and is cancelled there.
+    auto second = threadPool.addTask([&ran]() { ++ran; }, desc);
+    while (second->state() == TaskState::Queuing) {
+        std::this_thread::yield();
+    }
+    second->requestCancel();
+    EXPECT_EQ(second->waitFor(kRunTimeout), TaskState::Cancelled);
+    auto third = threadPool.addTask([&ran]() { ++ran; }, desc);
+    threadPool.stop();
+    EXPECT_EQ(third->waitFor(kRunTimeout), TaskState::Cancelled);
+    EXPECT_EQ(ran.load(), 1);
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+}
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
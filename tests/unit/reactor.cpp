@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/threadpools.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+LLWFLOWS_NS_USING
+
+#ifdef __linux__
+static auto waitFor(const std::function<bool()>& done) -> bool {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return done();
+}
+
+TEST(ReactorTest, Pipe) {
+    ThreadPool threadPool(2);
+    threadPool.start(true);
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::atomic<int>  fired{0};
+    std::atomic<bool> onWorker{false};
+    ASSERT_EQ(threadPool.reactor().watch(fds[0], EPOLLIN,
+                                         [&](uint32_t events) {
+                                             onWorker = ThreadWorker::currentWorker() != nullptr && (events & EPOLLIN);
+                                             ++fired;
+                                         }),
+              0);
+    EXPECT_EQ(threadPool.reactor().watch(fds[0], EPOLLIN, [](uint32_t) {}), -1);
+    EXPECT_EQ(threadPool.reactor().watchCount(), 1);
+    // nothing written, nothing fires.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(fired.load(), 0);
+
+    char value = 'x';
+    ASSERT_EQ(write(fds[1], &value, 1), 1);
+    EXPECT_TRUE(waitFor([&fired]() { return fired.load() == 1; }));
+    EXPECT_TRUE(onWorker.load());
+    // one shot, still readable but not watched any more.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(fired.load(), 1);
+    EXPECT_EQ(threadPool.reactor().watchCount(), 0);
+
+    EXPECT_EQ(threadPool.reactor().unwatch(fds[0]), 0);
+    EXPECT_EQ(threadPool.reactor().unwatch(fds[0]), -1);
+    close(fds[0]);
+    close(fds[1]);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ReactorTest, SocketPairPingPong) {
+    constexpr int    num_rounds = 1000;
+    ThreadPool       threadPool(2);
+    int              fds[2];
+    std::atomic<int> rounds{0};
+    threadPool.start(true);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    // each side answers what it reads, and watches again for the next message.
+    std::function<void(int, uint32_t)> echo = [&](int fd, uint32_t) {
+        int value = 0;
+        ASSERT_EQ(read(fd, &value, sizeof(value)), sizeof(value));
+        if (fd == fds[0]) {
+            rounds = value;
+        }
+        if (value >= num_rounds) {
+            return;
+        }
+        ++value;
+        ASSERT_EQ(write(fd, &value, sizeof(value)), sizeof(value));
+        threadPool.reactor().watch(fd, EPOLLIN, [&echo, fd](uint32_t events) { echo(fd, events); });
+    };
+    for (auto fd : fds) {
+        ASSERT_EQ(threadPool.reactor().watch(fd, EPOLLIN, [&echo, fd](uint32_t events) { echo(fd, events); }), 0);
+    }
+    int value = 0;
+    ASSERT_EQ(write(fds[1], &value, sizeof(value)), sizeof(value));
+    EXPECT_TRUE(waitFor([&rounds]() { return rounds.load() >= num_rounds - 1; }));
+    threadPool.reactor().unwatch(fds[0]);
+    threadPool.reactor().unwatch(fds[1]);
+    threadPool.stopAndwaitAll();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(ReactorTest, ExternalLoop) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    auto epollFd = threadPool.reactor().fd();
+    ASSERT_GE(epollFd, 0);
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::atomic<int> fired{0};
+    ASSERT_EQ(threadPool.reactor().watch(fds[0], EPOLLIN, [&fired](uint32_t) { ++fired; }), 0);
+    char value = 'x';
+    ASSERT_EQ(write(fds[1], &value, 1), 1);
+    // the loop of the application sees the reactor readable and lets it dispatch.
+    pollfd pfd{epollFd, POLLIN, 0};
+    ASSERT_EQ(::poll(&pfd, 1, 1000), 1);
+    EXPECT_EQ(threadPool.reactor().poll(0), 1);
+    EXPECT_TRUE(waitFor([&fired]() { return fired.load() == 1; }));
+    EXPECT_EQ(threadPool.reactor().poll(0), 0);
+    threadPool.reactor().unwatch(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(ReactorTest, StopDropsWatches) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::atomic<int> fired{0};
+    ASSERT_EQ(threadPool.reactor().watch(fds[0], EPOLLIN, [&fired](uint32_t) { ++fired; }), 0);
+    threadPool.stopAndwaitAll();
+    EXPECT_EQ(threadPool.reactor().watchCount(), 0);
+    EXPECT_EQ(fired.load(), 0);
+    close(fds[0]);
+    close(fds[1]);
+}
+#endif
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
 #include <bitset>
+#include <chrono>
 #include <thread>
+#include <vector>
 
 #include "../../workflows/detail/log.hpp"
 #include "../../workflows/sringbuffer.hpp"
@@ -64,6 +68,161 @@ TEST(RingBufferTest, MultiThreadWrite) {
     EXPECT_TRUE(bits.all());
 }
 
+TEST(RingBufferTest, SPSC) {
+    constexpr int                  num_items = 100000;
+    SRingBuffer<int, policy::SPSC> buffer(64);
+    std::thread                    producer([&buffer]() {
+        for (int i = 0; i < num_items; ++i) {
+            while (!buffer.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (int i = 0; i < num_items; ++i) {
+        int t = -1;
+        while (!buffer.pop(t)) {
+            std::this_thread::yield();
+        }
+        ASSERT_EQ(t, i);
+    }
+    producer.join();
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(RingBufferTest, MPSC) {
+    constexpr int                  num_producers = 8, num_items = 10000;
+    SRingBuffer<int, policy::MPSC> buffer(100);
+    std::thread                    producers[num_producers];
+    for (int i = 0; i < num_producers; ++i) {
+        producers[i] = std::thread([&buffer, count = i]() {
+            for (int j = 0; j < num_items; ++j) {
+                while (!buffer.push(count * num_items + j)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    // items of one producer keep their order.
+    std::vector<int> last(num_producers, -1);
+    for (int i = 0; i < num_producers * num_items; ++i) {
+        int t = -1;
+        while (!buffer.pop(t)) {
+            std::this_thread::yield();
+        }
+        ASSERT_GT(t % num_items, last[t / num_items]);
+        last[t / num_items] = t % num_items;
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    EXPECT_TRUE(buffer.empty());
+}
+
+template <typename Policy>
+static auto checkBatch(const int num_producers, const int num_consumers) -> void {
+    static constexpr int          num_items = 20000, batch = 7;
+    SRingBuffer<int, Policy>      buffer(64);
+    std::vector<std::thread>      threads;
+    std::vector<int>              seen(num_producers * num_items, 0);
+    std::atomic<int>              popped{0};
+    std::vector<std::vector<int>> orders(num_consumers);
+    for (int i = 0; i < num_producers; ++i) {
+        threads.emplace_back([&buffer, first = i * num_items]() {
+            int items[batch];
+            for (int j = 0; j < num_items;) {
+                const int count = std::min(batch, num_items - j);
+                for (int k = 0; k < count; ++k) {
+                    items[k] = first + j + k;
+                }
+                // a partial push leaves the tail of items untouched, push it again.
+                int pushed = 0;
+                while ((pushed += (int)buffer.try_push_n(items + pushed, count - pushed)) < count) {
+                    std::this_thread::yield();
+                }
+                j += count;
+            }
+        });
+    }
+    for (int i = 0; i < num_consumers; ++i) {
+        threads.emplace_back([&, idx = i]() {
+            int items[batch];
+            while (popped.load() < num_producers * num_items) {
+                const auto count = buffer.try_pop_n(items, batch);
+                if (count == 0) {
+                    std::this_thread::yield();
+                }
+                for (std::size_t k = 0; k < count; ++k) {
+                    orders[idx].push_back(items[k]);
+                }
+                popped.fetch_add((int)count);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& order : orders) {
+        // every consumer sees the items of one producer in order.
+        std::vector<int> last(num_producers, -1);
+        for (auto item : order) {
+            ASSERT_GT(item % num_items, last[item / num_items]);
+            last[item / num_items] = item % num_items;
+            ++seen[item];
+        }
+    }
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), num_producers * num_items);
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(RingBufferTest, Batch) {
+    checkBatch<policy::SPSC>(1, 1);
+    checkBatch<policy::MPSC>(4, 1);
+    checkBatch<policy::MPMC>(4, 4);
+}
+
+template <typename Policy>
+static auto benchmarkRingBuffer(const char* name) -> void {
+    constexpr int                num_ops = 2000000;
+    SRingBuffer<int64_t, Policy> buffer(1024);
+    int64_t                      sum = 0;
+    // uncontended cost of one push and one pop.
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_ops; ++i) {
+        buffer.push(i);
+        int64_t t = 0;
+        buffer.pop(t);
+        sum += t;
+    }
+    auto singleThread = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tStart);
+    // one producer thread and one consumer thread.
+    tStart = std::chrono::steady_clock::now();
+    std::thread producer([&buffer]() {
+        for (int i = 0; i < num_ops; ++i) {
+            while (!buffer.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (int i = 0; i < num_ops; ++i) {
+        int64_t t = 0;
+        while (!buffer.pop(t)) {
+            std::this_thread::yield();
+        }
+        sum += t;
+    }
+    producer.join();
+    auto twoThread = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tStart);
+    EXPECT_EQ(sum, int64_t(num_ops - 1) * num_ops);
+    LLWFLOWS_LOG_INFO("{}: push + pop {:.2f} ns/op in one thread, {:.2f} ns/op between two threads", name,
+                      (double)singleThread.count() / num_ops, (double)twoThread.count() / num_ops);
+}
+
+TEST(RingBufferTest, PolicyBenchmark) {
+    benchmarkRingBuffer<policy::SPSC>("SPSC");
+    benchmarkRingBuffer<policy::MPSC>("MPSC");
+    benchmarkRingBuffer<policy::MPMC>("MPMC");
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
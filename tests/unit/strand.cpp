@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/strand.hpp"
+
+LLWFLOWS_NS_USING
+
+TEST(StrandTest, SerialInOrder) {
+    constexpr int    num_test_threads = 4, num_producers = 4, num_items = 5000;
+    ThreadPool       threadPool(num_test_threads);
+    Strand           strand(threadPool);
+    std::atomic<int> running{0};
+    std::atomic<int> count{0};
+    std::vector<int> last(num_producers, -1);  // only touched inside the strand
+    bool             overlapped = false, reordered = false;
+    threadPool.start(true);
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < num_producers; ++i) {
+        producers.emplace_back([&, producer = i]() {
+            for (int j = 0; j < num_items; ++j) {
+                strand.post([&, producer, j]() {
+                    if (running.fetch_add(1) != 0) {
+                        overlapped = true;
+                    }
+                    if (last[producer] + 1 != j) {
+                        reordered = true;
+                    }
+                    last[producer] = j;
+                    ++count;
+                    running.fetch_sub(1);
+                });
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    threadPool.waitIdle();
+    EXPECT_EQ(count.load(), num_producers * num_items);
+    EXPECT_FALSE(overlapped);
+    EXPECT_FALSE(reordered);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(StrandTest, ManyStrands) {
+    constexpr int       num_test_threads = 4, num_strands = 100000, num_active = 1000, num_items = 4;
+    ThreadPool          threadPool(num_test_threads);
+    std::vector<Strand> strands;
+    std::vector<int>    values(num_strands, 0);
+    std::atomic<int>    errors{0};
+    strands.reserve(num_strands);
+    for (int i = 0; i < num_strands; ++i) {
+        strands.emplace_back(threadPool);
+    }
+    threadPool.start(true);
+
+    // a held strand costs no thread and no queue slot in the pool, only the active ones do.
+    auto tStart = std::chrono::steady_clock::now();
+    for (int first = 0; first < num_strands; first += num_active) {
+        for (int j = 0; j < num_items; ++j) {
+            for (int i = first; i < first + num_active; ++i) {
+                auto ret = strands[i].post([&, i, j]() {
+                    if (values[i]++ != j) {
+                        ++errors;
+                    }
+                });
+                ASSERT_EQ(ret, 0);
+            }
+        }
+        threadPool.waitIdle();
+    }
+    LLWFLOWS_LOG_INFO("{} strands x {} tasks take {} ms", num_strands, num_items,
+                      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart)
+                          .count());
+    EXPECT_EQ(errors.load(), 0);
+    for (int i = 0; i < num_strands; ++i) {
+        ASSERT_EQ(values[i], num_items);
+    }
+    threadPool.stopAndwaitAll();
+}
+
+TEST(StrandTest, RunningInThisThread) {
+    ThreadPool       threadPool(2);
+    Strand           strand(threadPool), other(threadPool);
+    std::atomic<int> checked{0};
+    threadPool.start();
+
+    EXPECT_FALSE(strand.runningInThisThread());
+    strand.post([&]() {
+        if (strand.runningInThisThread() && !other.runningInThisThread()) {
+            ++checked;
+        }
+    });
+    threadPool.waitIdle();
+    EXPECT_EQ(checked.load(), 1);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(StrandTest, YieldToQueuedTasks) {
+    constexpr int     num_items = Strand::kMaxDrainCount * 3;
+    ThreadPool        threadPool(1);
+    Strand            strand(threadPool);
+    std::atomic<bool> started{false}, queued{false};
+    std::atomic<int>  count{0}, countSeen{-1};
+    threadPool.start(true);
+    // the first task holds the drain until another task is queued on the only worker.
+    strand.post([&]() {
+        started = true;
+        while (!queued.load()) {
+            std::this_thread::yield();
+        }
+        ++count;
+    });
+    for (int i = 1; i < num_items; ++i) {
+        strand.post([&count]() { ++count; });
+    }
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    threadPool.addTask([&]() { countSeen = count.load(); });
+    queued = true;
+    threadPool.waitIdle();
+    EXPECT_EQ(count.load(), num_items);
+    // the drain yields after its budget, its continuation goes behind the other task, not before it.
+    EXPECT_EQ(countSeen.load(), Strand::kMaxDrainCount);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(StrandTest, DrainDropped) {
+    ThreadPool        threadPool(1);
+    Strand            strand(threadPool);
+    std::atomic<bool> release{false};
+    std::atomic<int>  count{0};
+    threadPool.start(true);
+    threadPool.addTask([&release]() {
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    EXPECT_EQ(strand.post([&count]() { ++count; }), 0);
+    // the queued drain is dropped by the stop, the strand is not left scheduled.
+    std::thread releaser([&release]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        release = true;
+    });
+    threadPool.stop();
+    releaser.join();
+    EXPECT_EQ(count.load(), 0);
+    // a stopped pool refuses the drain.
+    EXPECT_EQ(strand.post([&count]() { ++count; }), -1);
+
+    threadPool.start(true);
+    EXPECT_EQ(strand.post([&count]() { ++count; }), 0);
+    threadPool.waitIdle();
+    EXPECT_EQ(count.load(), 3);
+    threadPool.stopAndwaitAll();
+}
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
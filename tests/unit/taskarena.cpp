@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/profiler.hpp"
+#include "../../workflows/taskarena.hpp"
+#include "../../workflows/threadpools.hpp"
+
+LLWFLOWS_NS_USING
+
+TEST(TaskArenaTest, Allocate) {
+    auto arena = TaskArena::create(1024);
+    for (std::size_t alignment : {1, 8, 16, 64}) {
+        auto p = arena->allocate(24, alignment);
+        ASSERT_TRUE(p != nullptr);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(p) % alignment, 0);
+    }
+    EXPECT_EQ(arena->chunkCount(), 1);
+    // a big block takes a chunk of its own.
+    auto big = static_cast<char*>(arena->allocate(4096));
+    std::fill(big, big + 4096, 1);
+    EXPECT_EQ(arena->chunkCount(), 2);
+    EXPECT_EQ(arena->allocatedBytes(), 24 * 4 + 4096);
+
+    std::vector<int, ArenaAllocator<int>> values(ArenaAllocator<int>{arena});
+    for (int i = 0; i < 1000; ++i) {
+        values.push_back(i);
+    }
+    EXPECT_EQ(values[999], 999);
+}
+
+TEST(TaskArenaTest, MultiThreadAllocate) {
+    constexpr int            num_threads = 8, num_allocs = 10000;
+    auto                     arena = TaskArena::create();
+    std::vector<std::thread> threads;
+    std::atomic<int>         errors{0};
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&arena, &errors, value = i]() {
+            std::vector<int*> ptrs;
+            for (int j = 0; j < num_allocs; ++j) {
+                ptrs.push_back(static_cast<int*>(arena->allocate(sizeof(int), alignof(int))));
+                *ptrs.back() = value;
+            }
+            for (auto p : ptrs) {
+                errors += *p != value;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(errors.load(), 0);
+    EXPECT_EQ(arena->allocatedBytes(), num_threads * num_allocs * sizeof(int));
+}
+
+TEST(TaskArenaTest, WorkflowRun) {
+    constexpr int                             num_test_threads = 4, num_test_tasks = 1000;
+    ThreadPool                                threadPool(num_test_threads);
+    std::atomic<int>                          count{0};
+    std::vector<std::shared_ptr<TaskPromise>> promises;
+    threadPool.start(true);
+
+    auto                     arena = TaskArena::create();
+    std::weak_ptr<TaskArena> weakArena(arena);
+    TaskDescription          desc;
+    desc.arena = arena;
+    for (int i = 0; i < num_test_tasks; ++i) {
+        if (i > 0 && i % 10 == 0) {
+            desc.dependencies = {promises[i - 1]};
+        }
+        promises.push_back(threadPool.addTask([&count]() { ++count; }, desc));
+        ASSERT_TRUE(promises.back() != nullptr);
+    }
+    threadPool.waitIdle();
+    EXPECT_EQ(count.load(), num_test_tasks);
+    EXPECT_GE(arena->allocatedBytes(), num_test_tasks * (sizeof(TaskDescription) + sizeof(TaskPromise)));
+
+    threadPool.stopAndwaitAll();
+
+    // the run is over once the promises and the description are dropped, the arena goes in one shot.
+    desc  = TaskDescription();
+    arena = nullptr;
+    promises.clear();
+    EXPECT_TRUE(weakArena.expired());
+}
+
+TEST(TaskArenaTest, DelayedTask) {
+    ThreadPool threadPool(2);
+    threadPool.start();
+    auto            arena = TaskArena::create();
+    TaskDescription desc;
+    desc.arena   = arena;
+    auto promise = threadPool.addTaskAfter(std::chrono::milliseconds(1), []() {}, desc);
+    ASSERT_TRUE(promise != nullptr);
+    promise->wait();
+    EXPECT_EQ(promise->state(), TaskState::Done);
+    // the description with only the arena set is kept until the task is due.
+    EXPECT_GE(arena->allocatedBytes(), sizeof(TaskDescription));
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskArenaTest, RetryKeepsArena) {
+    ThreadPool threadPool(2);
+    auto       profiler = std::make_shared<Profiler>();
+    threadPool.setProfiler(profiler);
+    threadPool.start(true);
+    auto            arena   = TaskArena::create();
+    auto            blocker = std::make_shared<TaskPromise>();
+    TaskDescription desc;
+    desc.arena        = arena;
+    desc.dependencies = {blocker};
+    auto promise      = threadPool.addTask([]() {}, desc);
+    ASSERT_TRUE(promise != nullptr);
+    // the task is packed once, its retries queue the same closure and take nothing from the arena.
+    auto bytes = arena->allocatedBytes();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(arena->allocatedBytes(), bytes);
+    blocker->changeState(TaskState::Queuing, TaskState::Done);
+    EXPECT_EQ(promise->wait(), TaskState::Done);
+    threadPool.waitIdle();
+    auto records = profiler->records();
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_GT(records[0].retryCount, 0);
+    EXPECT_EQ(arena->allocatedBytes(), bytes);
+    threadPool.stopAndwaitAll();
+}
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
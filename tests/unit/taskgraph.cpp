@@ -0,0 +1,404 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../workflows/actuators.hpp"
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/taskgraph.hpp"
+#include "../../workflows/threadpools.hpp"
+
+LLWFLOWS_NS_USING
+
+static constexpr auto kRunTimeout = std::chrono::seconds(10);
+
+// three independent nodes added before a chain of four.
+static auto makeOrderGraph(TaskGraph& graph, std::vector<int>& order, std::mutex& mutex) -> void {
+    for (int i = 0; i < 7; ++i) {
+        graph.addNode([i, &order, &mutex]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(i);
+        });
+    }
+    for (int i = 3; i < 6; ++i) {
+        graph.addEdge(i, i + 1);
+    }
+}
+
+TEST(TaskGraphTest, CriticalPathOrder) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    std::vector<int> order;
+    std::mutex       mutex;
+    TaskGraph        graph;
+    makeOrderGraph(graph, order, mutex);
+    auto promise = graph.run(threadPool);
+    ASSERT_TRUE(promise != nullptr);
+    EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Done);
+    // the sink of the chain ties with the independent nodes, the node added first wins.
+    EXPECT_EQ(order, std::vector<int>({3, 4, 5, 0, 1, 2, 6}));
+    EXPECT_DOUBLE_EQ(graph.bottomLevel(3), 4.0);
+    EXPECT_DOUBLE_EQ(graph.bottomLevel(6), 1.0);
+    EXPECT_DOUBLE_EQ(graph.criticalPathLength(), 4.0);
+
+    order.clear();
+    graph.setSchedule(GraphSchedule::Fifo);
+    promise = graph.run(threadPool);
+    ASSERT_TRUE(promise != nullptr);
+    EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3, 4, 5, 6}));
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, Cost) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    TaskGraph graph;
+    auto      a = graph.addNode([]() {}, "a", 2.0);
+    auto      b = graph.addNode([]() {}, "b", 5.0);
+    auto      c = graph.addNode([]() {}, "c", 1.0);
+    auto      d = graph.addNode([]() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); }, "d", 1.0);
+    graph.addEdge(a, b);
+    graph.addEdge(a, c);
+    graph.addEdge(c, d);
+    EXPECT_EQ(graph.addEdge(a, 10), -1);
+    EXPECT_EQ(graph.name(b), TaskName("b"));
+
+    auto promise = graph.run(threadPool);
+    ASSERT_TRUE(promise != nullptr);
+    EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_DOUBLE_EQ(graph.bottomLevel(a), 7.0);
+    EXPECT_DOUBLE_EQ(graph.bottomLevel(c), 2.0);
+    EXPECT_DOUBLE_EQ(graph.measuredCost(d), 0.0);
+
+    graph.useMeasuredCost(true);
+    EXPECT_EQ(graph.run(threadPool)->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_GT(graph.measuredCost(d), 1000.0);
+    // measured from the second run on, d is now the longest path.
+    EXPECT_EQ(graph.run(threadPool)->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_GT(graph.bottomLevel(c), graph.bottomLevel(b));
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, Cycle) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    TaskGraph graph;
+    auto      a = graph.addNode([]() {});
+    auto      b = graph.addNode([]() {});
+    graph.addEdge(a, b);
+    graph.addEdge(b, a);
+    EXPECT_TRUE(graph.run(threadPool) == nullptr);
+
+    TaskGraph empty;
+    auto      promise = empty.run(threadPool);
+    ASSERT_TRUE(promise != nullptr);
+    EXPECT_EQ(promise->state(), TaskState::Done);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, Cancel) {
+    ThreadPool threadPool(1);
+    threadPool.start(true);
+    std::atomic<int> count{0};
+    TaskGraph        graph;
+    auto             first = graph.addNode([]() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+    for (int i = 0; i < 10; ++i) {
+        graph.addEdge(first, graph.addNode([&count]() { ++count; }));
+    }
+    auto promise = graph.run(threadPool);
+    ASSERT_TRUE(promise != nullptr);
+    EXPECT_TRUE(graph.run(threadPool) == nullptr);
+    promise->requestCancel();
+    EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Cancelled);
+    EXPECT_EQ(count.load(), 0);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, Wide) {
+    constexpr int    num_test_threads = 4, num_layers = 50, num_width = 40;
+    ThreadPool       threadPool(num_test_threads);
+    std::atomic<int> count{0};
+    TaskGraph        graph;
+    threadPool.start(true);
+    // layered graph, every node depends on two nodes of the layer before.
+    for (int layer = 0; layer < num_layers; ++layer) {
+        for (int i = 0; i < num_width; ++i) {
+            auto node = graph.addNode([&count]() { ++count; });
+            if (layer > 0) {
+                auto previous = (layer - 1) * num_width;
+                graph.addEdge(previous + i, node);
+                graph.addEdge(previous + (i + 1) % num_width, node);
+            }
+        }
+    }
+    for (auto schedule : {GraphSchedule::Fifo, GraphSchedule::CriticalPath}) {
+        count = 0;
+        graph.setSchedule(schedule);
+        auto tStart  = std::chrono::steady_clock::now();
+        auto promise = graph.run(threadPool);
+        ASSERT_TRUE(promise != nullptr);
+        EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Done);
+        auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart);
+        LLWFLOWS_LOG_INFO("graph of {} nodes, schedule {}: {} us", graph.nodeCount(), static_cast<int>(schedule),
+                          cost.count());
+        EXPECT_EQ(count.load(), num_layers * num_width);
+    }
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, ConditionLoop) {
+    constexpr int     num_iterations = 100;
+    ThreadPool        threadPool(2);
+    std::atomic<int>  iterations{0}, done{0};
+    std::atomic<bool> onWorkers{true};
+    double            value = 0.0;
+    TaskGraph         graph;
+    threadPool.start(true);
+    // init -> body -> check, check goes back to body until converged, then to exit.
+    auto init = graph.addNode([&]() { value = 1024.0; });
+    auto body = graph.addNode([&]() {
+        value = value / 2.0;
+        ++iterations;
+    });
+    auto check = graph.addCondition([&]() {
+        onWorkers = onWorkers && ThreadWorker::currentWorker() != nullptr;
+        return iterations.load() < num_iterations && value > 1.0 ? 0 : 1;
+    });
+    auto exit = graph.addNode([&done]() { ++done; });
+    graph.addEdge(init, body);
+    graph.addEdge(body, check);
+    EXPECT_EQ(graph.addEdge(check, body), 0);
+    EXPECT_EQ(graph.addEdge(check, exit), 0);
+    for (int round = 0; round < 3; ++round) {
+        iterations = 0;
+        auto promise = graph.run(threadPool);
+        ASSERT_TRUE(promise != nullptr);
+        EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Done);
+        EXPECT_EQ(iterations.load(), 10);
+        EXPECT_EQ(value, 1.0);
+        EXPECT_EQ(done.load(), round + 1);
+    }
+    EXPECT_TRUE(onWorkers.load());
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, ConditionBranch) {
+    ThreadPool       threadPool(2);
+    std::atomic<int> taken{-1}, after{0};
+    int              branch = 0;
+    TaskGraph        graph;
+    threadPool.start(true);
+    auto select = graph.addCondition([&branch]() { return branch; });
+    for (int i = 0; i < 2; ++i) {
+        auto node = graph.addNode([&taken, i]() { taken = i; });
+        graph.addEdge(select, node);
+        // the branch not taken skips its successors too.
+        graph.addEdge(node, graph.addNode([&after]() { ++after; }));
+    }
+    for (branch = -1; branch < 3; ++branch) {
+        taken = -1;
+        after = 0;
+        auto promise = graph.run(threadPool);
+        ASSERT_TRUE(promise != nullptr);
+        EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Done);
+        EXPECT_EQ(taken.load(), branch == 0 || branch == 1 ? branch : -1);
+        EXPECT_EQ(after.load(), branch == 0 || branch == 1 ? 1 : 0);
+    }
+
+    // a loop only entered by weak edges has no source to start from.
+    TaskGraph loop;
+    auto      a = loop.addCondition([]() { return 0; });
+    auto      b = loop.addCondition([]() { return 0; });
+    loop.addEdge(a, b);
+    loop.addEdge(b, a);
+    EXPECT_TRUE(loop.run(threadPool) == nullptr);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, Subflow) {
+    ThreadPool       threadPool(1);
+    std::atomic<int> children{0}, grandChildren{0}, seen{-1};
+    int              inputs = 0;
+    TaskGraph        graph;
+    threadPool.start(true);
+    // the count of children is only known when the node runs, one worker is enough as nothing waits for them.
+    auto scan = graph.addSubflow([&](TaskGraph& subflow) {
+        for (int i = 0; i < inputs; ++i) {
+            auto child = subflow.addSubflow([&](TaskGraph& nested) {
+                ++children;
+                nested.addNode([&grandChildren]() { ++grandChildren; });
+            });
+            subflow.addEdge(child, subflow.addNode([]() {}));
+        }
+    });
+    graph.addEdge(scan, graph.addNode([&]() { seen = children + grandChildren; }));
+    for (inputs = 0; inputs < 20; inputs += 7) {
+        children      = 0;
+        grandChildren = 0;
+        auto arena    = TaskArena::create();
+        auto promise  = graph.run(threadPool, arena);
+        ASSERT_TRUE(promise != nullptr);
+        EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Done);
+        EXPECT_EQ(seen.load(), inputs * 2);
+        EXPECT_GT(arena->allocatedBytes(), 0u);
+    }
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, Executors) {
+    ThreadPool threadPool(4);
+    threadPool.start(true);
+    std::atomic<int> active{0}, maxActive{0}, ran{0}, elsewhere{0};
+    std::function<bool()> onExecutor;
+    auto                  body = [&]() {
+        auto count = ++active;
+        for (auto max = maxActive.load(); count > max && !maxActive.compare_exchange_weak(max, count);) {
+        }
+        elsewhere += onExecutor() ? 0 : 1;
+        ++ran;
+        --active;
+    };
+    TaskGraph graph;
+    auto      fork = graph.addNode(body);
+    auto      join = graph.addNode(body);
+    for (int i = 0; i < 8; ++i) {
+        auto node = graph.addNode(body);
+        graph.addEdge(fork, node);
+        graph.addEdge(node, join);
+    }
+    // the child graph runs on the executor of its parent.
+    auto spawn = graph.addSubflow([&](TaskGraph& subflow) {
+        for (int i = 0; i < 4; ++i) {
+            subflow.addNode(body);
+        }
+    });
+    graph.addEdge(fork, spawn);
+    graph.addEdge(spawn, join);
+
+    StrandExecutor strand(threadPool);
+    onExecutor = []() { return true; };
+    EXPECT_EQ(graph.run(strand)->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(ran.load(), 14);
+    EXPECT_EQ(maxActive.load(), 1);
+
+    SingleThreadExecutor single("graph");
+    onExecutor = [&single]() { return single.runningInThisThread(); };
+    ran        = 0;
+    EXPECT_EQ(graph.run(single, TaskArena::create())->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(ran.load(), 14);
+    EXPECT_EQ(elsewhere.load(), 0);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, SubflowLoop) {
+    constexpr int             num_iterations = 50;
+    ThreadPool                threadPool(2);
+    std::atomic<int>          iterations{0}, ran{0};
+    std::atomic<TaskPromise*> run{nullptr};
+    std::atomic<std::size_t>  maxDependents{0};
+    TaskGraph                 graph;
+    threadPool.start(true);
+    // the subflow runs again at every turn of the loop, the run promise keeps at most the child run in flight.
+    auto spawn = graph.addSubflow([&](TaskGraph& subflow) {
+        subflow.addNode([&ran]() { ++ran; });
+        ++iterations;
+    });
+    auto check = graph.addCondition([&]() {
+        while (run.load() == nullptr) {
+            std::this_thread::yield();
+        }
+        auto count = run.load()->dependentCount();
+        for (auto max = maxDependents.load(); count > max && !maxDependents.compare_exchange_weak(max, count);) {
+        }
+        return iterations.load() < num_iterations ? 0 : 1;
+    });
+    graph.addEdge(graph.addNode([]() {}), spawn);
+    graph.addEdge(spawn, check);
+    EXPECT_EQ(graph.addEdge(check, spawn), 0);
+    auto promise = graph.run(threadPool);
+    ASSERT_TRUE(promise != nullptr);
+    run = promise.get();
+    EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Done);
+    EXPECT_EQ(ran.load(), num_iterations);
+    EXPECT_LE(maxDependents.load(), 1u);
+    EXPECT_EQ(promise->dependentCount(), 0u);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, SubflowCancel) {
+    ThreadPool        threadPool(2);
+    std::atomic<bool> started{false}, release{false};
+    std::atomic<int>  count{0};
+    TaskGraph         graph;
+    threadPool.start(true);
+    graph.addSubflow([&](TaskGraph& subflow) {
+        auto first = subflow.addNode([&]() {
+            started = true;
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+        for (int i = 0; i < 10; ++i) {
+            subflow.addEdge(first, subflow.addNode([&count]() { ++count; }));
+        }
+    });
+    auto promise = graph.run(threadPool);
+    ASSERT_TRUE(promise != nullptr);
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    // the cancel of the parent run reaches the subflow in flight.
+    promise->requestCancel();
+    release = true;
+    EXPECT_EQ(promise->waitFor(kRunTimeout), TaskState::Cancelled);
+    EXPECT_EQ(count.load(), 0);
+    threadPool.stopAndwaitAll();
+}
+
+TEST(TaskGraphTest, Stop) {
+    ThreadPool        threadPool(1);
+    std::atomic<bool> started{false}, release{false};
+    std::atomic<int>  ran{0};
+    TaskGraph         graph;
+    threadPool.start(true);
+    // the first node of the subflow holds the only worker, the slots of the other ones wait in its queue.
+    auto spawn = graph.addSubflow([&](TaskGraph& subflow) {
+        auto first = subflow.addNode([&]() {
+            started = true;
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+        subflow.addEdge(first, subflow.addNode([&ran]() { ++ran; }));
+        for (int i = 0; i < 3; ++i) {
+            subflow.addNode([&ran]() { ++ran; });
+        }
+    });
+    graph.addEdge(spawn, graph.addNode([&ran]() { ++ran; }));
+    auto promise = graph.run(threadPool);
+    ASSERT_TRUE(promise != nullptr);
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    // the queued slots are dropped and the ones added meanwhile refused, the subflow and the run still end.
+    std::thread releaser([&release]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        release = true;
+    });
+    threadPool.stop();
+    releaser.join();
+    EXPECT_EQ(promise->state(), TaskState::Cancelled);
+    EXPECT_EQ(ran.load(), 0);
+    EXPECT_EQ(threadPool.outstandingTaskCount(), 0);
+}
+
+int main(int argc, char** argv) {
+    Thread::makeMetaObjectForCurrentThread("main");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../../workflows/detail/log.hpp"
+#include "../../workflows/timerwheel.hpp"
+
+LLWFLOWS_NS_USING
+
+using Clock = TimerWheel<int>::Clock;
+
+TEST(TimerWheelTest, Basic) {
+    auto            start = Clock::now();
+    TimerWheel<int> wheel(std::chrono::milliseconds(1), start);
+
+    for (int i = 0; i < 100; ++i) {
+        wheel.schedule(start + std::chrono::milliseconds(100 - i), 100 - i);
+    }
+    EXPECT_EQ(wheel.size(), 100);
+
+    std::vector<int> expired;
+    for (int ms = 0; ms <= 100; ++ms) {
+        wheel.advance(start + std::chrono::milliseconds(ms), [&expired, ms](Clock::time_point, int&& value) {
+            EXPECT_EQ(value, ms);
+            expired.push_back(value);
+        });
+    }
+    ASSERT_EQ(expired.size(), 100);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(expired[i], i + 1);
+    }
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, Cascade) {
+    auto                 start = Clock::now();
+    TimerWheel<int64_t>  wheel(std::chrono::milliseconds(1), start);
+    std::mt19937_64      rng(42);
+    std::vector<int64_t> deadlines;
+    constexpr int        num_timers = 100000;
+    constexpr int64_t    max_delay  = 10 * 60 * 1000;  // 10 minutes
+    for (int i = 0; i < num_timers; ++i) {
+        deadlines.push_back(rng() % max_delay + 1);
+        wheel.schedule(start + std::chrono::milliseconds(deadlines.back()), deadlines.back());
+    }
+    // big and irregular steps, timers must never fire early and never be lost.
+    int     count = 0;
+    int64_t now   = 0;
+    while (now < max_delay + 1) {
+        now += rng() % 5000;
+        wheel.advance(start + std::chrono::milliseconds(now), [&count, now](Clock::time_point, int64_t&& deadline) {
+            EXPECT_LE(deadline, now);
+            ++count;
+        });
+    }
+    EXPECT_EQ(count, num_timers);
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, NextExpiry) {
+    auto            start = Clock::now();
+    TimerWheel<int> wheel(std::chrono::milliseconds(1), start);
+    EXPECT_EQ(wheel.nextExpiry(), Clock::time_point::max());
+    wheel.schedule(start + std::chrono::milliseconds(10), 10);
+    EXPECT_EQ(wheel.nextExpiry(), start + std::chrono::milliseconds(10));
+    wheel.schedule(start + std::chrono::seconds(10), 10000);
+    // far timers only need a wake up every turn of level 0.
+    wheel.advance(start + std::chrono::milliseconds(10), [](Clock::time_point, int&&) {});
+    EXPECT_LE(wheel.nextExpiry(), start + std::chrono::milliseconds(64));
+    int count = 0;
+    wheel.clear([&count](Clock::time_point, int&&) { ++count; });
+    EXPECT_EQ(count, 1);
+}
+
+TEST(TimerWheelTest, MillionTimers) {
+    auto            start = Clock::now();
+    TimerWheel<int> wheel(std::chrono::milliseconds(1), start);
+    auto            t0 = Clock::now();
+    for (int i = 0; i < 1000000; ++i) {
+        wheel.schedule(start + std::chrono::milliseconds(i % 100000 + 1), i);
+    }
+    auto t1    = Clock::now();
+    int  count = 0;
+    wheel.advance(start + std::chrono::milliseconds(100000), [&count](Clock::time_point, int&&) { ++count; });
+    auto t2 = Clock::now();
+    EXPECT_EQ(count, 1000000);
+    LLWFLOWS_LOG_INFO("schedule 1000000 timers take {} ms, expire take {} ms",
+                      std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count(),
+                      std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count());
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,29 @@
+#include "actuators.hpp"
+
+LLWFLOWS_NS_BEGIN
+SingleThreadExecutor::SingleThreadExecutor(const char* name, const std::size_t capacity) : mTasks(capacity) {
+    mThread.setName(name);
+    mThread.start([this]() {
+        std::function<void()> task;
+        while (mTasks.receive(task) == ChannelStatus::Ok) {
+            task();
+            task = nullptr;
+        }
+    });
+}
+
+SingleThreadExecutor::~SingleThreadExecutor() {
+    // the thread drains what was queued before the close, then leaves.
+    mTasks.close();
+    mThread.join();
+}
+
+auto SingleThreadExecutor::execute(std::function<void()> task) -> int {
+    return mTasks.trySend(std::move(task)) == ChannelStatus::Ok ? 0 : -1;
+}
+
+auto SingleThreadExecutor::runningInThisThread() const -> bool {
+    return std::hash<std::thread::id>()(std::this_thread::get_id()) == mThread.id();
+}
+
+LLWFLOWS_NS_END
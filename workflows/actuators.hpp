@@ -1 +1,153 @@
 #pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "channel.hpp"
+#include "detail/workflowsglobal.hpp"
+#include "strand.hpp"
+#include "thread.hpp"
+#include "threadpools.hpp"
+
+#if LLWFLOWS_CPP_PLUS >= 20
+#include <concepts>
+#endif
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief executors, the one thing algorithms need from a scheduler
+ *
+ * an executor has `execute(task) -> int`, returning 0 if the task will run and -1 if it was refused. algorithms take
+ * the executor as a template parameter, so the scheduler is picked at compile time and the call is bound statically,
+ * InlineExecutor even inlines the task into the algorithm.
+ */
+#if LLWFLOWS_CPP_PLUS >= 20
+template <typename E>
+concept Executor = requires(E& executor, std::function<void()> task) {
+    { executor.execute(std::move(task)) } -> std::convertible_to<int>;
+};
+#define LLWFLOWS_EXECUTOR Executor
+#else
+#define LLWFLOWS_EXECUTOR typename
+#endif
+
+///> @brief run the task in the calling thread at once
+class InlineExecutor {
+public:
+    template <typename F>
+    inline auto execute(F&& task) -> int {
+        std::forward<F>(task)();
+        return 0;
+    }
+};
+
+/**
+ * @brief run tasks in FIFO order on one dedicated thread
+ *
+ * @note
+ * the queue is bounded, execute() returns -1 when it is full. tasks queued before the executor is destroyed still run.
+ */
+class LLWFLOWS_API SingleThreadExecutor {
+public:
+    explicit SingleThreadExecutor(const char* name = "executor", const std::size_t capacity = 1024);
+    ~SingleThreadExecutor();
+
+    auto execute(std::function<void()> task) -> int;
+    auto runningInThisThread() const -> bool;
+
+private:
+    SingleThreadExecutor(const SingleThreadExecutor&)                    = delete;
+    auto operator=(const SingleThreadExecutor&) -> SingleThreadExecutor& = delete;
+
+    Channel<std::function<void()>, policy::MPSC> mTasks;
+    Thread                                       mThread;
+};
+
+///> @brief run tasks on any worker of a pool, the pool must outlive the executor
+class PoolExecutor {
+public:
+    explicit PoolExecutor(ThreadPool& pool) : mPool(&pool) {}
+
+    inline auto execute(std::function<void()> task) -> int { return mPool->post(std::move(task)); }
+    inline auto pool() const -> ThreadPool& { return *mPool; }
+
+private:
+    ThreadPool* mPool;
+};
+
+///> @brief run tasks one by one in FIFO order on a pool, through a strand
+class StrandExecutor {
+public:
+    explicit StrandExecutor(ThreadPool& pool) : mStrand(pool) {}
+    explicit StrandExecutor(Strand strand) : mStrand(std::move(strand)) {}
+
+    inline auto execute(std::function<void()> task) -> int { return mStrand.post(std::move(task)); }
+    inline auto strand() const -> const Strand& { return mStrand; }
+
+private:
+    Strand mStrand;
+};
+
+/**
+ * @brief call func(i) for every i in [begin, end) on executor, return when all calls are finished
+ *
+ * the range is split in chunks of grain indexes, the calling thread runs the last chunk itself. on a worker thread it
+ * keeps running other tasks of the worker while it waits, like ThreadPool::wait().
+ *
+ * @note do not call it from the thread of a SingleThreadExecutor with that same executor, it waits for itself.
+ * @return int -1 if the executor refused a chunk, the chunks it took are still finished before returning.
+ */
+template <LLWFLOWS_EXECUTOR E, typename F>
+auto parallelFor(E& executor, const std::size_t begin, const std::size_t end, const std::size_t grain, F&& func)
+    -> int {
+    if (begin >= end) {
+        return 0;
+    }
+    const auto step = std::max<std::size_t>(grain, 1);
+    // shared with the chunks, the last one still notifies after the caller may have returned.
+    auto pending = std::make_shared<std::atomic<int>>(0);
+    int  result  = 0;
+    auto first   = begin;
+    for (; end - first > step; first += step) {
+        pending->fetch_add(1, std::memory_order_relaxed);
+        auto submitted = executor.execute([pending, &func, first, last = first + step]() {
+            for (auto i = first; i < last; ++i) {
+                func(i);
+            }
+            pending->fetch_sub(1, std::memory_order_acq_rel);
+#if LLWFLOWS_CPP_PLUS >= 20
+            pending->notify_all();
+#endif
+        });
+        if (submitted != 0) {
+            pending->fetch_sub(1, std::memory_order_relaxed);
+            result = -1;
+            break;
+        }
+    }
+    if (result == 0) {
+        for (auto i = first; i < end; ++i) {
+            func(i);
+        }
+    }
+    if (auto worker = ThreadWorker::currentWorker(); worker != nullptr) {
+        worker->helpWhile([&pending]() { return pending->load(std::memory_order_acquire) != 0; });
+    }
+    for (auto count = pending->load(std::memory_order_acquire); count != 0;
+         count      = pending->load(std::memory_order_acquire)) {
+#if LLWFLOWS_CPP_PLUS >= 20
+        pending->wait(count, std::memory_order_acquire);
+#else
+        std::this_thread::yield();
+#endif
+    }
+    return result;
+}
+
+LLWFLOWS_NS_END
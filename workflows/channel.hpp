@@ -0,0 +1,436 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "detail/log.hpp"
+#include "sringbuffer.hpp"
+#include "threadpools.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+enum class ChannelStatus {
+    Ok,
+    Empty,   ///> nothing to receive now, the channel is still open
+    Full,    ///> no room to send now
+    Closed,  ///> closed, and nothing left to receive for a receiver
+};
+
+/**
+ * @brief bounded typed channel between tasks, built on SRingBuffer
+ *
+ * try* never block. send()/receive() sleep on a condition variable until they can go on. receiveAsync() and
+ * sendAsync() park a callback (and the item to send) without holding any worker, the other side wakes it as a new pool
+ * task, use them for stages running in a pool.
+ *
+ * the fast path is the lock-free ring buffer only, the mutex is taken only when somebody blocks or parks.
+ *
+ * @note
+ * close() stops new sends, items already sent can still be received, then receivers get Closed.
+ * a task blocked in send()/receive() holds its worker, it does not help like ThreadPool::wait(): the task it runs
+ * meanwhile could be the other end of the same channel and block above it forever.
+ * receiveAsync() and sendAsync() need the channel owned by a std::shared_ptr, e.g. made by create().
+ */
+template <typename T, typename Policy = policy::MPMC>
+class Channel : public std::enable_shared_from_this<Channel<T, Policy>> {
+public:
+    using ReceiveCallback = std::function<void(std::optional<T>)>;
+    using SendCallback    = std::function<void(ChannelStatus)>;
+
+    explicit Channel(const std::size_t capacity);
+    ~Channel() = default;
+    static auto create(const std::size_t capacity) -> std::shared_ptr<Channel>;
+
+    auto trySend(T&& item) -> ChannelStatus;
+    auto trySend(const T& item) -> ChannelStatus;
+    ///> @brief wait for room, return Ok or Closed
+    auto send(T&& item) -> ChannelStatus;
+    auto send(const T& item) -> ChannelStatus;
+    auto tryReceive(T& item) -> ChannelStatus;
+    ///> @brief wait for an item, return Ok or Closed
+    auto receive(T& item) -> ChannelStatus;
+    /**
+     * @brief receive one item in a task of pool
+     *
+     * callback runs in a pool task with the item, or std::nullopt once the channel is closed and empty. while the
+     * channel is empty it is parked, not queued, so it holds no worker.
+     *
+     * @return int -1 if the channel is not owned by a std::shared_ptr or the pool refused the task (e.g. it is
+     * stopping), the callback is dropped then.
+     */
+    auto receiveAsync(ThreadPool& pool, ReceiveCallback callback) -> int;
+    /**
+     * @brief send item in a task of pool
+     *
+     * callback runs in a pool task with Ok once the item is in the channel, or Closed if the channel was closed first
+     * (the item is dropped). while the channel is full the item and callback are parked, not queued, so they hold no
+     * worker.
+     *
+     * @return int -1 if the channel is not owned by a std::shared_ptr or the pool refused the task, the item and the
+     * callback are dropped then.
+     */
+    auto sendAsync(ThreadPool& pool, T item, SendCallback callback) -> int;
+    auto close() -> void;
+    auto isClosed() const -> bool;
+    auto size() const -> std::size_t;
+    auto capacity() const -> std::size_t;
+
+private:
+    Channel(const Channel&)                    = delete;
+    auto operator=(const Channel&) -> Channel& = delete;
+
+    struct Parked {
+        ThreadPool*     pool;
+        ReceiveCallback callback;
+    };
+    // shared by the task closures, which must be copyable whatever T is
+    struct ParkedSend {
+        ThreadPool*  pool;
+        T            item;
+        SendCallback callback;
+    };
+
+    ///> @brief push or pop without waking anybody, safe under mMutex
+    template <typename U>
+    auto pushItem(U&& item) -> ChannelStatus;
+    auto popItem(T& item) -> ChannelStatus;
+    template <typename U>
+    auto sendImp(U&& item) -> ChannelStatus;
+    auto afterSend() -> void;
+    auto afterReceive() -> void;
+    auto addReceiveTask(ThreadPool& pool, ReceiveCallback callback) -> int;
+    auto receiveOrPark(ThreadPool& pool, ReceiveCallback callback) -> void;
+    ///> @brief add the parked receivers back to their pools, one or all of them
+    auto wakeParked(const bool all) -> void;
+    auto addSendTask(std::shared_ptr<ParkedSend> parked) -> int;
+    auto sendOrPark(std::shared_ptr<ParkedSend> parked) -> void;
+    ///> @brief add the parked senders back to their pools, one or all of them
+    auto wakeParkedSends(const bool all) -> void;
+
+private:
+    SRingBuffer<T, Policy>                  mBuffer;
+    std::atomic<bool>                       mClosed{false};
+    std::mutex                              mMutex;
+    std::condition_variable                 mNotEmpty;
+    std::condition_variable                 mNotFull;
+    std::atomic<int>                        mReceiveWaiters{0};
+    std::atomic<int>                        mSendWaiters{0};
+    std::atomic<int>                        mParkedCount{0};
+    std::deque<Parked>                      mParked;
+    std::atomic<int>                        mParkedSendCount{0};
+    std::deque<std::shared_ptr<ParkedSend>> mParkedSends;
+};
+
+template <typename T, typename Policy>
+Channel<T, Policy>::Channel(const std::size_t capacity) : mBuffer(capacity) {}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::create(const std::size_t capacity) -> std::shared_ptr<Channel> {
+    return std::make_shared<Channel>(capacity);
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::trySend(T&& item) -> ChannelStatus {
+    auto status = pushItem(std::move(item));
+    if (status == ChannelStatus::Ok) {
+        afterSend();
+    }
+    return status;
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::trySend(const T& item) -> ChannelStatus {
+    auto status = pushItem(item);
+    if (status == ChannelStatus::Ok) {
+        afterSend();
+    }
+    return status;
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::send(T&& item) -> ChannelStatus {
+    return sendImp(std::move(item));
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::send(const T& item) -> ChannelStatus {
+    return sendImp(item);
+}
+
+template <typename T, typename Policy>
+template <typename U>
+auto Channel<T, Policy>::sendImp(U&& item) -> ChannelStatus {
+    // the buffer only takes the item on success, so it can be tried again.
+    auto status = trySend(std::forward<U>(item));
+    if (status != ChannelStatus::Full) {
+        return status;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mSendWaiters.fetch_add(1, std::memory_order_seq_cst);
+        mNotFull.wait(lock, [this, &item, &status]() {
+            status = pushItem(std::forward<U>(item));
+            return status != ChannelStatus::Full;
+        });
+        mSendWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (status == ChannelStatus::Ok) {
+        afterSend();
+    }
+    return status;
+}
+
+template <typename T, typename Policy>
+template <typename U>
+auto Channel<T, Policy>::pushItem(U&& item) -> ChannelStatus {
+    if (mClosed.load(std::memory_order_acquire)) {
+        return ChannelStatus::Closed;
+    }
+    return mBuffer.push(std::forward<U>(item)) ? ChannelStatus::Ok : ChannelStatus::Full;
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::popItem(T& item) -> ChannelStatus {
+    if (mBuffer.pop(item)) {
+        return ChannelStatus::Ok;
+    }
+    if (!mClosed.load(std::memory_order_acquire)) {
+        return ChannelStatus::Empty;
+    }
+    // a send may have landed right before the close.
+    return mBuffer.pop(item) ? ChannelStatus::Ok : ChannelStatus::Closed;
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::tryReceive(T& item) -> ChannelStatus {
+    auto status = popItem(item);
+    if (status == ChannelStatus::Ok) {
+        afterReceive();
+    }
+    return status;
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::receive(T& item) -> ChannelStatus {
+    auto status = tryReceive(item);
+    if (status != ChannelStatus::Empty) {
+        return status;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mReceiveWaiters.fetch_add(1, std::memory_order_seq_cst);
+        mNotEmpty.wait(lock, [this, &item, &status]() {
+            status = popItem(item);
+            return status != ChannelStatus::Empty;
+        });
+        mReceiveWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (status == ChannelStatus::Ok) {
+        afterReceive();
+    }
+    return status;
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::receiveAsync(ThreadPool& pool, ReceiveCallback callback) -> int {
+    if (this->weak_from_this().expired()) {
+        LLWFLOWS_LOG_ERROR("Channel must be owned by a std::shared_ptr to receive asynchronously.");
+        return -1;
+    }
+    return addReceiveTask(pool, std::move(callback));
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::sendAsync(ThreadPool& pool, T item, SendCallback callback) -> int {
+    if (this->weak_from_this().expired()) {
+        LLWFLOWS_LOG_ERROR("Channel must be owned by a std::shared_ptr to send asynchronously.");
+        return -1;
+    }
+    return addSendTask(std::make_shared<ParkedSend>(ParkedSend{&pool, std::move(item), std::move(callback)}));
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::close() -> void {
+    if (mClosed.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+    }
+    mNotEmpty.notify_all();
+    mNotFull.notify_all();
+    wakeParked(true);
+    wakeParkedSends(true);
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::isClosed() const -> bool {
+    return mClosed.load(std::memory_order_acquire);
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::size() const -> std::size_t {
+    return mBuffer.size();
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::capacity() const -> std::size_t {
+    return mBuffer.capacity();
+}
+
+// a waiter counts itself before it checks the buffer under the lock, and the other side checks the count after it
+// changed the buffer, the full fences make sure at least one of them sees the other.
+template <typename T, typename Policy>
+auto Channel<T, Policy>::afterSend() -> void {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mReceiveWaiters.load(std::memory_order_relaxed) > 0) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+        }
+        mNotEmpty.notify_one();
+    }
+    if (mParkedCount.load(std::memory_order_relaxed) > 0) {
+        wakeParked(false);
+    }
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::afterReceive() -> void {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mSendWaiters.load(std::memory_order_relaxed) > 0) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+        }
+        mNotFull.notify_one();
+    }
+    if (mParkedSendCount.load(std::memory_order_relaxed) > 0) {
+        wakeParkedSends(false);
+    }
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::addReceiveTask(ThreadPool& pool, ReceiveCallback callback) -> int {
+    auto promise = pool.addTask(
+        [self = this->shared_from_this(), pool = &pool, callback = std::move(callback)]() mutable {
+            self->receiveOrPark(*pool, std::move(callback));
+        });
+    // a stopping pool returns the task already cancelled, it will not run either.
+    if (promise == nullptr || promise->state() == TaskState::Cancelled) {
+        LLWFLOWS_LOG_ERROR("Channel add receive task failed.");
+        return -1;
+    }
+    return 0;
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::receiveOrPark(ThreadPool& pool, ReceiveCallback callback) -> void {
+    T    item;
+    auto status = tryReceive(item);
+    if (status == ChannelStatus::Empty) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mParkedCount.fetch_add(1, std::memory_order_seq_cst);
+            status = popItem(item);
+            if (status == ChannelStatus::Empty) {
+                mParked.push_back(Parked{&pool, std::move(callback)});
+                return;
+            }
+            mParkedCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (status == ChannelStatus::Ok) {
+            afterReceive();
+        }
+    }
+    if (status == ChannelStatus::Ok) {
+        callback(std::optional<T>(std::move(item)));
+    } else {
+        callback(std::nullopt);
+    }
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::wakeParked(const bool all) -> void {
+    std::deque<Parked> woken;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (all) {
+            woken.swap(mParked);
+        } else if (!mParked.empty()) {
+            woken.push_back(std::move(mParked.front()));
+            mParked.pop_front();
+        }
+        mParkedCount.fetch_sub(static_cast<int>(woken.size()), std::memory_order_relaxed);
+    }
+    // a woken receiver tries again and parks again if another receiver was faster.
+    for (auto& parked : woken) {
+        if (addReceiveTask(*parked.pool, parked.callback) != 0) {
+            // handed back, a later wake tries it again (e.g. once its pool runs again).
+            LLWFLOWS_LOG_WARN("Channel receiver stays parked, its pool refused the task.");
+            std::lock_guard<std::mutex> lock(mMutex);
+            mParkedCount.fetch_add(1, std::memory_order_relaxed);
+            mParked.push_front(std::move(parked));
+        }
+    }
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::addSendTask(std::shared_ptr<ParkedSend> parked) -> int {
+    auto& pool    = *parked->pool;
+    auto  promise = pool.addTask([self = this->shared_from_this(), parked]() { self->sendOrPark(parked); });
+    if (promise == nullptr || promise->state() == TaskState::Cancelled) {
+        LLWFLOWS_LOG_ERROR("Channel add send task failed.");
+        return -1;
+    }
+    return 0;
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::sendOrPark(std::shared_ptr<ParkedSend> parked) -> void {
+    // the buffer only takes the item on success, so it can be tried again.
+    auto status = pushItem(std::move(parked->item));
+    if (status == ChannelStatus::Full) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mParkedSendCount.fetch_add(1, std::memory_order_seq_cst);
+        status = pushItem(std::move(parked->item));
+        if (status == ChannelStatus::Full) {
+            mParkedSends.push_back(std::move(parked));
+            return;
+        }
+        mParkedSendCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (status == ChannelStatus::Ok) {
+        afterSend();
+    }
+    parked->callback(status);
+}
+
+template <typename T, typename Policy>
+auto Channel<T, Policy>::wakeParkedSends(const bool all) -> void {
+    std::deque<std::shared_ptr<ParkedSend>> woken;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (all) {
+            woken.swap(mParkedSends);
+        } else if (!mParkedSends.empty()) {
+            woken.push_back(std::move(mParkedSends.front()));
+            mParkedSends.pop_front();
+        }
+        mParkedSendCount.fetch_sub(static_cast<int>(woken.size()), std::memory_order_relaxed);
+    }
+    // a woken sender tries again and parks again if another sender took the room.
+    for (auto& parked : woken) {
+        if (addSendTask(parked) != 0) {
+            LLWFLOWS_LOG_WARN("Channel sender stays parked, its pool refused the task.");
+            std::lock_guard<std::mutex> lock(mMutex);
+            mParkedSendCount.fetch_add(1, std::memory_order_relaxed);
+            mParkedSends.push_front(std::move(parked));
+        }
+    }
+}
+
+LLWFLOWS_NS_END
@@ -245,6 +245,70 @@ public:
         }
     }
 
+    /// Pushes up to count items moved from items, claiming all slots with one CAS.
+    /// Only the leading slots free in this turn are claimed. Returns the number of
+    /// items pushed, items after that are left untouched.
+    size_t try_push_n(T* items, size_t count) noexcept {
+        static_assert(std::is_nothrow_move_constructible<T>::value, "T must be nothrow move constructible");
+        count     = count < capacity_ ? count : capacity_;
+        auto head = head_.load(std::memory_order_acquire);
+        for (;;) {
+            size_t free = 0;
+            while (free < count &&
+                   turn(head + free) * 2 == slots_[idx(head + free)].turn.load(std::memory_order_acquire)) {
+                ++free;
+            }
+            if (free == 0) {
+                auto const prevHead = head;
+                head                = head_.load(std::memory_order_acquire);
+                if (head == prevHead) {
+                    return 0;
+                }
+                continue;
+            }
+            if (head_.compare_exchange_strong(head, head + free)) {
+                for (size_t i = 0; i < free; ++i) {
+                    auto& slot = slots_[idx(head + i)];
+                    slot.construct(std::move(items[i]));
+                    slot.turn.store(turn(head + i) * 2 + 1, std::memory_order_release);
+                }
+                return free;
+            }
+        }
+    }
+
+    /// Pops up to count items into items, claiming all slots with one CAS.
+    /// Only the leading slots already written are claimed. Returns the number of
+    /// items popped.
+    size_t try_pop_n(T* items, size_t count) noexcept {
+        count     = count < capacity_ ? count : capacity_;
+        auto tail = tail_.load(std::memory_order_acquire);
+        for (;;) {
+            size_t ready = 0;
+            while (ready < count &&
+                   turn(tail + ready) * 2 + 1 == slots_[idx(tail + ready)].turn.load(std::memory_order_acquire)) {
+                ++ready;
+            }
+            if (ready == 0) {
+                auto const prevTail = tail;
+                tail                = tail_.load(std::memory_order_acquire);
+                if (tail == prevTail) {
+                    return 0;
+                }
+                continue;
+            }
+            if (tail_.compare_exchange_strong(tail, tail + ready)) {
+                for (size_t i = 0; i < ready; ++i) {
+                    auto& slot = slots_[idx(tail + i)];
+                    items[i]   = slot.move();
+                    slot.destroy();
+                    slot.turn.store(turn(tail + i) * 2 + 2, std::memory_order_release);
+                }
+                return ready;
+            }
+        }
+    }
+
     /// Returns the number of elements in the queue.
     /// The size can be negative when the queue is empty and there is at least one
     /// reader waiting. Since this is a concurrent queue the size is only a best
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "workflowsglobal.hpp"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ctime>
+#endif
+
+LLWFLOWS_NS_BEGIN
+namespace detail {
+inline constexpr std::chrono::steady_clock::time_point kNoDeadline = std::chrono::steady_clock::time_point::max();
+
+/**
+ * @brief block while word still holds expected, until woken by futexWake or deadline
+ *
+ * @note
+ * it may return early (woken for another value, signal), callers re-check their condition in a loop. word must be a 32
+ * bits atomic, e.g. of an enum with int as underlying type. on linux it is the futex syscall on the word itself,
+ * elsewhere std::atomic::wait for an untimed wait in C++20 and a sleep which backs off up to 1ms otherwise.
+ */
+template <typename T>
+inline auto futexWait(std::atomic<T>& word, const T expected,
+                      const std::chrono::steady_clock::time_point deadline = kNoDeadline) -> void {
+    static_assert(sizeof(std::atomic<T>) == sizeof(uint32_t), "futex word must be 32 bits");
+    const bool timed = deadline != kNoDeadline;
+#ifdef __linux__
+    timespec  timeout{};
+    timespec* timeoutPtr = nullptr;
+    if (timed) {
+        auto left = deadline - std::chrono::steady_clock::now();
+        if (left <= std::chrono::nanoseconds::zero()) {
+            return;
+        }
+        auto ns         = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+        timeout.tv_sec  = static_cast<time_t>(ns / 1000000000);
+        timeout.tv_nsec = static_cast<long>(ns % 1000000000);
+        timeoutPtr      = &timeout;
+    }
+    T value = expected;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE,
+            *reinterpret_cast<const uint32_t*>(&value), timeoutPtr, nullptr, 0);
+#else
+#if LLWFLOWS_CPP_PLUS >= 20
+    if (!timed) {
+        word.wait(expected, std::memory_order_acquire);
+        return;
+    }
+#endif
+    auto sleep = std::chrono::microseconds(50);
+    while (word.load(std::memory_order_acquire) == expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+            sleep, std::max<std::chrono::steady_clock::duration>(deadline - std::chrono::steady_clock::now(), {})));
+        sleep = std::min<std::chrono::microseconds>(sleep * 2, std::chrono::milliseconds(1));
+    }
+#endif
+}
+
+///> @brief wake all threads blocked by futexWait on word
+template <typename T>
+inline auto futexWakeAll(std::atomic<T>& word) -> void {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#elif LLWFLOWS_CPP_PLUS >= 20
+    word.notify_all();
+#endif
+}
+
+///> @brief wake one thread blocked by futexWait on word
+template <typename T>
+inline auto futexWakeOne(std::atomic<T>& word) -> void {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#elif LLWFLOWS_CPP_PLUS >= 20
+    word.notify_one();
+#endif
+}
+}  // namespace detail
+LLWFLOWS_NS_END
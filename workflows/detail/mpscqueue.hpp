@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "MPMCQueue.h"
+#include "workflowsglobal.hpp"
+
+LLWFLOWS_NS_BEGIN
+namespace detail {
+/**
+ * @brief bounded multiple producer single consumer queue
+ *
+ * every slot carries a sequence number telling whose turn it is. producers claim a slot by CAS on the tail, the
+ * consumer is alone on the head so it only needs a load and two stores per pop.
+ *
+ * @note any thread may push, only one thread may pop at the same time.
+ */
+template <typename T>
+class MPSCQueue {
+    static_assert(std::is_nothrow_destructible<T>::value, "T must be nothrow destructible");
+
+public:
+    explicit MPSCQueue(const std::size_t capacity);
+    ~MPSCQueue();
+
+    template <typename... Args>
+    auto try_emplace(Args&&... args) noexcept -> bool;
+    auto try_pop(T& item) noexcept -> bool;
+    ///> @brief push up to count items moved from items, claiming the slots with one CAS. return count pushed.
+    auto try_push_n(T* items, std::size_t count) noexcept -> std::size_t;
+    ///> @brief pop up to count items into items with one store of head. return count popped.
+    auto try_pop_n(T* items, std::size_t count) noexcept -> std::size_t;
+    auto size() const noexcept -> std::ptrdiff_t;
+    auto empty() const noexcept -> bool;
+    auto capacity() const noexcept -> std::size_t;
+
+private:
+    static constexpr std::size_t kCacheLine = rigtorp::mpmc::hardwareInterferenceSize;
+    struct Slot {
+        std::atomic<std::size_t>                                   sequence{0};
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        inline auto get() noexcept -> T* { return reinterpret_cast<T*>(&storage); }
+    };
+
+    MPSCQueue(const MPSCQueue&)                    = delete;
+    auto operator=(const MPSCQueue&) -> MPSCQueue& = delete;
+
+private:
+    const std::size_t       mCapacity;
+    std::unique_ptr<Slot[]> mSlots;
+    alignas(kCacheLine) std::atomic<std::size_t> mHead{0};
+    alignas(kCacheLine) std::atomic<std::size_t> mTail{0};
+};
+
+template <typename T>
+MPSCQueue<T>::MPSCQueue(const std::size_t capacity) : mCapacity(capacity) {
+    if (mCapacity < 1) {
+        throw std::invalid_argument("capacity < 1");
+    }
+    mSlots.reset(new Slot[mCapacity]);
+    for (std::size_t i = 0; i < mCapacity; ++i) {
+        mSlots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+MPSCQueue<T>::~MPSCQueue() {
+    for (auto pos = mHead.load(std::memory_order_relaxed); pos != mTail.load(std::memory_order_relaxed); ++pos) {
+        mSlots[pos % mCapacity].get()->~T();
+    }
+}
+
+template <typename T>
+template <typename... Args>
+inline auto MPSCQueue<T>::try_emplace(Args&&... args) noexcept -> bool {
+    static_assert(std::is_nothrow_constructible<T, Args&&...>::value,
+                  "T must be nothrow constructible with Args&&...");
+    auto pos = mTail.load(std::memory_order_relaxed);
+    for (;;) {
+        auto&      slot     = mSlots[pos % mCapacity];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto diff     = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                new (slot.get()) T(std::forward<Args>(args)...);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // the consumer has not freed this slot of last turn yet.
+            return false;
+        } else {
+            pos = mTail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+inline auto MPSCQueue<T>::try_pop(T& item) noexcept -> bool {
+    const auto pos  = mHead.load(std::memory_order_relaxed);
+    auto&      slot = mSlots[pos % mCapacity];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    item = std::move(*slot.get());
+    slot.get()->~T();
+    slot.sequence.store(pos + mCapacity, std::memory_order_release);
+    mHead.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+template <typename T>
+inline auto MPSCQueue<T>::try_push_n(T* items, std::size_t count) noexcept -> std::size_t {
+    static_assert(std::is_nothrow_move_constructible<T>::value, "T must be nothrow move constructible");
+    if (count == 0) {
+        return 0;
+    }
+    count    = count < mCapacity ? count : mCapacity;
+    auto pos = mTail.load(std::memory_order_relaxed);
+    for (;;) {
+        std::size_t free = 0;
+        while (free < count &&
+               mSlots[(pos + free) % mCapacity].sequence.load(std::memory_order_acquire) == pos + free) {
+            ++free;
+        }
+        if (free == 0) {
+            const auto sequence = mSlots[pos % mCapacity].sequence.load(std::memory_order_acquire);
+            if (static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos) < 0) {
+                return 0;
+            }
+            pos = mTail.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (mTail.compare_exchange_weak(pos, pos + free, std::memory_order_relaxed)) {
+            for (std::size_t i = 0; i < free; ++i) {
+                auto& slot = mSlots[(pos + i) % mCapacity];
+                new (slot.get()) T(std::move(items[i]));
+                slot.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            return free;
+        }
+    }
+}
+
+template <typename T>
+inline auto MPSCQueue<T>::try_pop_n(T* items, std::size_t count) noexcept -> std::size_t {
+    const auto  pos   = mHead.load(std::memory_order_relaxed);
+    std::size_t ready = 0;
+    while (ready < count &&
+           mSlots[(pos + ready) % mCapacity].sequence.load(std::memory_order_acquire) == pos + ready + 1) {
+        auto& slot   = mSlots[(pos + ready) % mCapacity];
+        items[ready] = std::move(*slot.get());
+        slot.get()->~T();
+        slot.sequence.store(pos + ready + mCapacity, std::memory_order_release);
+        ++ready;
+    }
+    if (ready > 0) {
+        mHead.store(pos + ready, std::memory_order_relaxed);
+    }
+    return ready;
+}
+
+template <typename T>
+inline auto MPSCQueue<T>::size() const noexcept -> std::ptrdiff_t {
+    auto size =
+        static_cast<std::ptrdiff_t>(mTail.load(std::memory_order_relaxed) - mHead.load(std::memory_order_relaxed));
+    return size < 0 ? 0 : size;
+}
+
+template <typename T>
+inline auto MPSCQueue<T>::empty() const noexcept -> bool {
+    return size() <= 0;
+}
+
+template <typename T>
+inline auto MPSCQueue<T>::capacity() const noexcept -> std::size_t {
+    return mCapacity;
+}
+}  // namespace detail
+LLWFLOWS_NS_END
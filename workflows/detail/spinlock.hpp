@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "workflowsglobal.hpp"
+
+LLWFLOWS_NS_BEGIN
+namespace detail {
+/**
+ * @brief test and test-and-set lock for very short critical sections
+ *
+ * @note satisfy Lockable, so it can be used with std::lock_guard and std::unique_lock.
+ */
+class SpinLock {
+public:
+    SpinLock() noexcept = default;
+
+    inline auto lock() noexcept -> void {
+        while (mLocked.exchange(true, std::memory_order_acquire)) {
+            int spin = 0;
+            while (mLocked.load(std::memory_order_relaxed)) {
+                if (++spin > 64) {
+                    std::this_thread::yield();
+                    spin = 0;
+                }
+            }
+        }
+    }
+    inline auto try_lock() noexcept -> bool {
+        return !mLocked.load(std::memory_order_relaxed) && !mLocked.exchange(true, std::memory_order_acquire);
+    }
+    inline auto unlock() noexcept -> void { mLocked.store(false, std::memory_order_release); }
+
+private:
+    SpinLock(const SpinLock&)                    = delete;
+    auto operator=(const SpinLock&) -> SpinLock& = delete;
+
+private:
+    std::atomic<bool> mLocked{false};
+};
+}  // namespace detail
+LLWFLOWS_NS_END
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "MPMCQueue.h"
+#include "workflowsglobal.hpp"
+
+LLWFLOWS_NS_BEGIN
+namespace detail {
+/**
+ * @brief bounded single producer single consumer queue
+ *
+ * each side only writes its own index and keeps a cached copy of the other side's index, so in the common case a push
+ * or a pop is a plain load plus a release store, no read-modify-write at all.
+ *
+ * @note only one thread may push and only one thread may pop at the same time.
+ */
+template <typename T>
+class SPSCQueue {
+    static_assert(std::is_nothrow_destructible<T>::value, "T must be nothrow destructible");
+
+public:
+    explicit SPSCQueue(const std::size_t capacity);
+    ~SPSCQueue();
+
+    template <typename... Args>
+    auto try_emplace(Args&&... args) noexcept -> bool;
+    auto try_pop(T& item) noexcept -> bool;
+    ///> @brief push up to count items moved from items, published by one store. return count pushed.
+    auto try_push_n(T* items, std::size_t count) noexcept -> std::size_t;
+    ///> @brief pop up to count items into items, released by one store. return count popped.
+    auto try_pop_n(T* items, std::size_t count) noexcept -> std::size_t;
+    auto size() const noexcept -> std::ptrdiff_t;
+    auto empty() const noexcept -> bool;
+    auto capacity() const noexcept -> std::size_t;
+
+private:
+    SPSCQueue(const SPSCQueue&)                    = delete;
+    auto operator=(const SPSCQueue&) -> SPSCQueue& = delete;
+
+    auto next(std::size_t idx) const noexcept -> std::size_t;
+    auto slot(std::size_t idx) noexcept -> T*;
+
+private:
+    static constexpr std::size_t kCacheLine = rigtorp::mpmc::hardwareInterferenceSize;
+    using Storage                           = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    const std::size_t          mCapacity;
+    std::unique_ptr<Storage[]> mSlots;
+    // consumer side
+    alignas(kCacheLine) std::atomic<std::size_t> mHead{0};
+    std::size_t mTailCache{0};
+    // producer side
+    alignas(kCacheLine) std::atomic<std::size_t> mTail{0};
+    std::size_t mHeadCache{0};
+};
+
+template <typename T>
+SPSCQueue<T>::SPSCQueue(const std::size_t capacity) : mCapacity(capacity) {
+    if (mCapacity < 1) {
+        throw std::invalid_argument("capacity < 1");
+    }
+    // one slot is always left empty to tell full from empty.
+    mSlots.reset(new Storage[mCapacity + 1]);
+}
+
+template <typename T>
+SPSCQueue<T>::~SPSCQueue() {
+    for (auto idx = mHead.load(std::memory_order_relaxed); idx != mTail.load(std::memory_order_relaxed);
+         idx      = next(idx)) {
+        slot(idx)->~T();
+    }
+}
+
+template <typename T>
+template <typename... Args>
+inline auto SPSCQueue<T>::try_emplace(Args&&... args) noexcept -> bool {
+    static_assert(std::is_nothrow_constructible<T, Args&&...>::value,
+                  "T must be nothrow constructible with Args&&...");
+    const auto tail     = mTail.load(std::memory_order_relaxed);
+    const auto nextTail = next(tail);
+    if (nextTail == mHeadCache) {
+        mHeadCache = mHead.load(std::memory_order_acquire);
+        if (nextTail == mHeadCache) {
+            return false;
+        }
+    }
+    new (slot(tail)) T(std::forward<Args>(args)...);
+    mTail.store(nextTail, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+inline auto SPSCQueue<T>::try_pop(T& item) noexcept -> bool {
+    const auto head = mHead.load(std::memory_order_relaxed);
+    if (head == mTailCache) {
+        mTailCache = mTail.load(std::memory_order_acquire);
+        if (head == mTailCache) {
+            return false;
+        }
+    }
+    item = std::move(*slot(head));
+    slot(head)->~T();
+    mHead.store(next(head), std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+inline auto SPSCQueue<T>::try_push_n(T* items, std::size_t count) noexcept -> std::size_t {
+    static_assert(std::is_nothrow_move_constructible<T>::value, "T must be nothrow move constructible");
+    const auto tail = mTail.load(std::memory_order_relaxed);
+    auto       free = [this, tail]() {
+        return static_cast<std::size_t>(mHeadCache > tail ? mHeadCache - tail - 1 : mCapacity - tail + mHeadCache);
+    };
+    if (free() < count) {
+        mHeadCache = mHead.load(std::memory_order_acquire);
+    }
+    count    = count < free() ? count : free();
+    auto idx = tail;
+    for (std::size_t i = 0; i < count; ++i, idx = next(idx)) {
+        new (slot(idx)) T(std::move(items[i]));
+    }
+    if (count > 0) {
+        mTail.store(idx, std::memory_order_release);
+    }
+    return count;
+}
+
+template <typename T>
+inline auto SPSCQueue<T>::try_pop_n(T* items, std::size_t count) noexcept -> std::size_t {
+    const auto head  = mHead.load(std::memory_order_relaxed);
+    auto       ready = [this, head]() {
+        return static_cast<std::size_t>(mTailCache >= head ? mTailCache - head : mCapacity + 1 - head + mTailCache);
+    };
+    if (ready() < count) {
+        mTailCache = mTail.load(std::memory_order_acquire);
+    }
+    count    = count < ready() ? count : ready();
+    auto idx = head;
+    for (std::size_t i = 0; i < count; ++i, idx = next(idx)) {
+        items[i] = std::move(*slot(idx));
+        slot(idx)->~T();
+    }
+    if (count > 0) {
+        mHead.store(idx, std::memory_order_release);
+    }
+    return count;
+}
+
+template <typename T>
+inline auto SPSCQueue<T>::size() const noexcept -> std::ptrdiff_t {
+    auto size = static_cast<std::ptrdiff_t>(mTail.load(std::memory_order_relaxed)) -
+                static_cast<std::ptrdiff_t>(mHead.load(std::memory_order_relaxed));
+    return size < 0 ? size + static_cast<std::ptrdiff_t>(mCapacity + 1) : size;
+}
+
+template <typename T>
+inline auto SPSCQueue<T>::empty() const noexcept -> bool {
+    return size() <= 0;
+}
+
+template <typename T>
+inline auto SPSCQueue<T>::capacity() const noexcept -> std::size_t {
+    return mCapacity;
+}
+
+template <typename T>
+inline auto SPSCQueue<T>::next(std::size_t idx) const noexcept -> std::size_t {
+    return idx == mCapacity ? 0 : idx + 1;
+}
+
+template <typename T>
+inline auto SPSCQueue<T>::slot(std::size_t idx) noexcept -> T* {
+    return reinterpret_cast<T*>(&mSlots[idx]);
+}
+}  // namespace detail
+LLWFLOWS_NS_END
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "spinlock.hpp"
+#include "workflowsglobal.hpp"
+
+LLWFLOWS_NS_BEGIN
+namespace detail {
+/**
+ * @brief bounded deque owned by one thread, the owner works on the back and other threads steal from the front
+ *
+ * the owner push and pop in LIFO order so the newest item, whose data is most likely still in cache, runs first.
+ * thieves take the oldest item, which is usually the biggest piece of work left. both sides take a spin lock which is
+ * uncontended unless a thief is stealing at the same time, and empty checks are done without it.
+ *
+ * @note only the owner may push_back and pop_back, any thread may steal.
+ */
+template <typename T>
+class WorkStealingDeque {
+    static_assert(std::is_nothrow_destructible<T>::value, "T must be nothrow destructible");
+
+public:
+    explicit WorkStealingDeque(const std::size_t capacity);
+    ~WorkStealingDeque();
+
+    auto push_back(T&& item) noexcept -> bool;
+    auto pop_back(T& item) noexcept -> bool;
+    ///> @brief pop the front item, can be called by any thread.
+    auto steal(T& item) noexcept -> bool;
+    auto size() const noexcept -> std::size_t;
+    auto empty() const noexcept -> bool;
+    auto capacity() const noexcept -> std::size_t;
+
+private:
+    WorkStealingDeque(const WorkStealingDeque&)                    = delete;
+    auto operator=(const WorkStealingDeque&) -> WorkStealingDeque& = delete;
+
+    auto slot(std::size_t idx) noexcept -> T*;
+
+private:
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    const std::size_t          mCapacity;
+    std::unique_ptr<Storage[]> mSlots;
+    SpinLock                   mLock;
+    // monotonic indices, only written under lock but read without it for size().
+    std::atomic<std::size_t> mHead{0};
+    std::atomic<std::size_t> mTail{0};
+};
+
+template <typename T>
+WorkStealingDeque<T>::WorkStealingDeque(const std::size_t capacity) : mCapacity(capacity) {
+    if (mCapacity < 1) {
+        throw std::invalid_argument("capacity < 1");
+    }
+    mSlots.reset(new Storage[mCapacity]);
+}
+
+template <typename T>
+WorkStealingDeque<T>::~WorkStealingDeque() {
+    for (auto idx = mHead.load(std::memory_order_relaxed); idx != mTail.load(std::memory_order_relaxed); ++idx) {
+        slot(idx)->~T();
+    }
+}
+
+template <typename T>
+inline auto WorkStealingDeque<T>::push_back(T&& item) noexcept -> bool {
+    static_assert(std::is_nothrow_move_constructible<T>::value, "T must be nothrow move constructible");
+    std::lock_guard<SpinLock> lock(mLock);
+    const auto                tail = mTail.load(std::memory_order_relaxed);
+    if (tail - mHead.load(std::memory_order_relaxed) >= mCapacity) {
+        return false;
+    }
+    new (slot(tail)) T(std::move(item));
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+inline auto WorkStealingDeque<T>::pop_back(T& item) noexcept -> bool {
+    if (empty()) {
+        return false;
+    }
+    std::lock_guard<SpinLock> lock(mLock);
+    const auto                tail = mTail.load(std::memory_order_relaxed);
+    if (tail == mHead.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    item = std::move(*slot(tail - 1));
+    slot(tail - 1)->~T();
+    mTail.store(tail - 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+inline auto WorkStealingDeque<T>::steal(T& item) noexcept -> bool {
+    if (empty()) {
+        return false;
+    }
+    std::lock_guard<SpinLock> lock(mLock);
+    const auto                head = mHead.load(std::memory_order_relaxed);
+    if (head == mTail.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    item = std::move(*slot(head));
+    slot(head)->~T();
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+inline auto WorkStealingDeque<T>::size() const noexcept -> std::size_t {
+    const auto head = mHead.load(std::memory_order_acquire);
+    const auto tail = mTail.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+}
+
+template <typename T>
+inline auto WorkStealingDeque<T>::empty() const noexcept -> bool {
+    return size() == 0;
+}
+
+template <typename T>
+inline auto WorkStealingDeque<T>::capacity() const noexcept -> std::size_t {
+    return mCapacity;
+}
+
+template <typename T>
+inline auto WorkStealingDeque<T>::slot(std::size_t idx) noexcept -> T* {
+    return reinterpret_cast<T*>(&mSlots[idx % mCapacity]);
+}
+}  // namespace detail
+LLWFLOWS_NS_END
@@ -0,0 +1,179 @@
+#include "executionplan.hpp"
+
+#include <vector>
+
+#include "detail/log.hpp"
+
+LLWFLOWS_NS_BEGIN
+ExecutionPlan::ExecutionPlan(ThreadPool& pool) : mPool(pool) {}
+
+auto ExecutionPlan::replay() -> std::shared_ptr<TaskPromise> {
+    if (mRunPromise != nullptr &&
+        (mRunPromise->state() == TaskState::Queuing || mRunPromise->state() == TaskState::Running)) {
+        LLWFLOWS_LOG_WARN("Execution plan is still running.");
+        return nullptr;
+    }
+    if (mPool.mStopping.load(std::memory_order_acquire)) {
+        LLWFLOWS_LOG_WARN("Threadpool is stopping, execution plan is not replayed.");
+        return nullptr;
+    }
+    mRunPromise = std::make_shared<TaskPromise>();
+    mRunPromise->changeState(TaskState::Queuing, TaskState::Running);
+    auto promise = mRunPromise;
+    if (mNodes.empty()) {
+        promise->done();
+        return promise;
+    }
+    mRemaining.store(static_cast<int>(mNodes.size()), std::memory_order_relaxed);
+    mSkipped.store(false, std::memory_order_relaxed);
+    for (auto& node : mNodes) {
+        node.pending.store(node.predecessorCount, std::memory_order_relaxed);
+        node.skipped.store(false, std::memory_order_relaxed);
+        // the node completing the last replay is finished by its worker right after, wait for that before reset.
+        if (node.promise->state() == TaskState::Running) {
+            node.promise->wait();
+        }
+        node.promise->resetWorkerHistory();
+        node.promise->resetState();
+    }
+    for (int i = 0; i < static_cast<int>(mNodes.size()); ++i) {
+        if (mNodes[i].predecessorCount == 0) {
+            postNode(i);
+        }
+    }
+    return promise;
+}
+
+auto ExecutionPlan::taskCount() const -> int { return static_cast<int>(mNodes.size()); }
+
+auto ExecutionPlan::promise(const int node) const -> std::shared_ptr<TaskPromise> {
+    return isValid(node) ? mNodes[node].promise : nullptr;
+}
+
+auto ExecutionPlan::workerId(const int node) const -> int { return isValid(node) ? mNodes[node].workerId : -1; }
+
+auto ExecutionPlan::name(const int node) const -> TaskName { return isValid(node) ? mNodes[node].name : TaskName(); }
+
+auto ExecutionPlan::record(std::function<void()> task, TaskDescription&& desc) -> std::shared_ptr<TaskPromise> {
+    auto  index = static_cast<int>(mNodes.size());
+    auto& node  = mNodes.emplace_back();
+    node.func            = std::move(task);
+    node.name            = desc.name;
+    node.specifyWorkerId = desc.specifyWorkerId;
+    node.affinityKey     = desc.affinityKey;
+    node.promise         = desc.promise != nullptr ? std::move(desc.promise) : std::make_shared<TaskPromise>();
+    for (auto& dep : desc.dependencies) {
+        auto iter = mIndex.find(dep.get());
+        if (iter == mIndex.end()) {
+            LLWFLOWS_LOG_WARN("Dependency of captured task[{}] is not captured, it is dropped.", node.name.view());
+            continue;
+        }
+        auto& predecessor = mNodes[iter->second];
+        predecessor.successors.push_back(index);
+        if (node.firstPredecessor == -1) {
+            node.firstPredecessor = iter->second;
+        }
+        ++node.predecessorCount;
+    }
+    mIndex.emplace(node.promise.get(), index);
+    return node.promise;
+}
+
+auto ExecutionPlan::freeze() -> void {
+    mIndex.clear();
+    auto workerCount = mPool.workerCount();
+    // nodes are captured after their dependencies, so every predecessor already has its worker.
+    for (int i = 0; i < static_cast<int>(mNodes.size()); ++i) {
+        auto& node = mNodes[i];
+        if (node.specifyWorkerId >= 0 && node.specifyWorkerId < workerCount) {
+            node.workerId = node.specifyWorkerId;
+        } else if (node.affinityKey != 0) {
+            node.workerId = mPool.pickWorkerIdByAffinity(node.affinityKey);
+        } else if (node.firstPredecessor != -1 && mNodes[node.firstPredecessor].successors.front() == i) {
+            // the first successor continues the chain on the worker which has its input in cache.
+            node.workerId = mNodes[node.firstPredecessor].workerId;
+        }
+        if (node.workerId == -1) {
+            node.workerId = mPool.pickWorkerIdByRoundRobin();
+        }
+        node.task = Task{NodeRunner{this, i}, node.promise};
+    }
+}
+
+auto ExecutionPlan::postNode(const int node) -> void {
+    auto& workers = mPool.workers();
+    Task  task(mNodes[node].task);
+    mPool.mOutstandingTasks.fetch_add(1);
+    if (mNodes[node].skipped.load(std::memory_order_acquire) || mPool.mStopping.load(std::memory_order_acquire)) {
+        task.taskPromise->cancel();
+        skipNode(node);
+        return;
+    }
+    for (std::size_t i = 0; i < workers.size(); ++i) {
+        // a full queue does not lose the node, the next worker takes it.
+        if (workers[(mNodes[node].workerId + i) % workers.size()].post(std::move(task)) == 0) {
+            return;
+        }
+    }
+    LLWFLOWS_LOG_ERROR("Execution plan post task[{}] failed, run it here.", mNodes[node].name.view());
+    task.taskPromise->changeState(TaskState::Queuing, TaskState::Running);
+    runNode(node);
+    task.taskPromise->done();
+}
+
+auto ExecutionPlan::runNode(const int node) -> void {
+    if (!mRunPromise->isCancelRequested()) {
+        mNodes[node].func();
+    }
+    finishNode(node, false);
+}
+
+auto ExecutionPlan::skipNode(const int node) -> void {
+    mSkipped.store(true, std::memory_order_relaxed);
+    finishNode(node, true);
+}
+
+auto ExecutionPlan::finishNode(int node, bool skipped) -> void {
+    // the successors of a skipped node are skipped in this loop, a long cancelled chain does not recurse.
+    std::vector<int> skips;
+    auto&            pool = mPool;
+    while (true) {
+        for (auto successor : mNodes[node].successors) {
+            if (skipped) {
+                mNodes[successor].skipped.store(true, std::memory_order_release);
+            }
+            if (mNodes[successor].pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                continue;
+            }
+            if (mNodes[successor].skipped.load(std::memory_order_acquire)) {
+                pool.mOutstandingTasks.fetch_add(1);
+                mNodes[successor].promise->cancel();
+                skips.push_back(successor);
+            } else {
+                postNode(successor);
+            }
+        }
+        if (mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            // the plan may be replayed or destroyed once the run promise is finished, nothing of it is touched after.
+            auto promise = mRunPromise;
+            if (promise->isCancelRequested() || mSkipped.load(std::memory_order_relaxed)) {
+                promise->changeState(TaskState::Running, TaskState::Cancelled);
+            } else {
+                promise->done();
+            }
+        }
+        pool.taskFinished();
+        if (skips.empty()) {
+            return;
+        }
+        node    = skips.back();
+        skipped = true;
+        skips.pop_back();
+    }
+}
+
+auto ExecutionPlan::isValid(const int node) const -> bool {
+    return node >= 0 && node < static_cast<int>(mNodes.size());
+}
+
+LLWFLOWS_NS_END
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "taskname.hpp"
+#include "threadpools.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief frozen task graph captured from ThreadPool::addTask, replayed as many times as needed
+ *
+ * between ThreadPool::beginCapture() and endCapture() the tasks added by the capturing thread are recorded instead of
+ * run, the promise returned for each is the one of its node and can be used as a dependency of later tasks as usual.
+ * endCapture() freezes them: every node gets its worker once (pinned, affinity, the worker of its predecessor for a
+ * chain, round robin otherwise) and its Task is built once.
+ *
+ * a replay only resets the states and posts the ready nodes straight to their workers. there is no worker selection,
+ * no description copy and no allocation: the Task and the promise of a node are reused every time. the callables are
+ * the captured ones, let them read their inputs through references which change between replays. a node cancelled
+ * before it runs (ThreadPool::cancel(), stop()) is skipped with all its successors, and the replay ends Cancelled.
+ *
+ * @note
+ * priority, retries, arenas and latches of the captured descriptions are not used, dependencies on promises not
+ * captured are dropped. the plan must outlive its replays, and it can not be replayed again while a replay is in
+ * flight. the run promise is done when the last node returned, its own promise is finished by its worker right after.
+ */
+class LLWFLOWS_API ExecutionPlan {
+public:
+    ~ExecutionPlan() = default;
+
+    /**
+     * @brief run all captured tasks once
+     *
+     * @return std::shared_ptr<TaskPromise> promise of the replay, Cancelled if a cancel was requested on it (nodes not
+     * started yet are skipped) or a node was cancelled. nullptr if a replay is in flight or the pool is stopping.
+     */
+    auto replay() -> std::shared_ptr<TaskPromise>;
+    auto taskCount() const -> int;
+    ///> @brief promise of node, the same object the capture returned for it
+    auto promise(const int node) const -> std::shared_ptr<TaskPromise>;
+    ///> @brief worker assigned to node when the plan was frozen
+    auto workerId(const int node) const -> int;
+    auto name(const int node) const -> TaskName;
+
+private:
+    friend class ThreadPool;
+
+    explicit ExecutionPlan(ThreadPool& pool);
+    ExecutionPlan(const ExecutionPlan&)                    = delete;
+    auto operator=(const ExecutionPlan&) -> ExecutionPlan& = delete;
+
+    // what a worker runs for a node, named so a node dropped by a worker can be recognized
+    struct NodeRunner {
+        ExecutionPlan* plan;
+        int            node;
+        auto           operator()() -> void { plan->runNode(node); }
+    };
+    struct Node {
+        std::function<void()>        func;
+        TaskName                     name;
+        std::shared_ptr<TaskPromise> promise;
+        int                          specifyWorkerId{-1};
+        uint64_t                     affinityKey{0};
+        std::vector<int>             successors;
+        int                          firstPredecessor{-1};
+        int                          predecessorCount{0};
+        int                          workerId{-1};
+        Task                         task;  ///> built by freeze(), copied to the worker queue on every replay
+        std::atomic<int>             pending{0};
+        std::atomic<bool>            skipped{false};  ///> a predecessor was cancelled, the node is skipped too
+    };
+
+    ///> @brief add task to the plan instead of running it, called by ThreadPool::addTask while capturing
+    auto record(std::function<void()> task, TaskDescription&& desc) -> std::shared_ptr<TaskPromise>;
+    ///> @brief assign workers and build the tasks of all nodes
+    auto freeze() -> void;
+    auto postNode(const int node) -> void;
+    auto runNode(const int node) -> void;
+    ///> @brief finish node which was cancelled before it ran (e.g. ThreadPool::cancel(), stop()), its successors too
+    auto skipNode(const int node) -> void;
+    ///> @brief release the successors of node and the replay if it was the last one, skipped if it did not run
+    auto finishNode(int node, bool skipped) -> void;
+    auto isValid(const int node) const -> bool;
+
+private:
+    ThreadPool&                                  mPool;
+    std::deque<Node>                             mNodes;
+    std::unordered_map<const TaskPromise*, int> mIndex;  ///> node of each promise, only used while capturing
+    std::shared_ptr<TaskPromise>                 mRunPromise;
+    std::atomic<int>                             mRemaining{0};
+    std::atomic<bool>                            mSkipped{false};  ///> a node of the replay was skipped
+};
+
+LLWFLOWS_NS_END
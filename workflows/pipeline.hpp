@@ -0,0 +1,371 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "actuators.hpp"
+#include "detail/log.hpp"
+#include "detail/spinlock.hpp"
+#include "threadpools.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief how a pipeline stage may run
+ *
+ * SerialInOrder: one item at a time, in the order the source produced them.
+ * SerialOutOfOrder: one item at a time, in whatever order they arrive.
+ * Parallel: any number of items at once.
+ */
+enum class StageMode { SerialInOrder, SerialOutOfOrder, Parallel };
+
+/**
+ * @brief streaming pipeline over a bounded number of items in flight
+ *
+ * the source is called serially to fill an item, then the item goes through the stages in order. a task keeps carrying
+ * the same item through the following stages while it can, so its data stays in the cache of one worker, and only
+ * hands over at a serial stage busy with another item. such an item waits there and is picked up as a new task when
+ * the stage is free, an in order stage keeps waiting items in a ring indexed by their sequence, so reordering is O(1).
+ *
+ * at most maxTokens items are in flight, their storage is allocated once per run and reused, so memory stays bounded
+ * for an unbounded input.
+ *
+ * @note
+ * an item is one T for all stages, hold the data of every stage in it (e.g. the line, the record, the output). a slot
+ * is reused without being reset, the source must overwrite what it needs. the pipeline must outlive its runs.
+ */
+template <typename T>
+class Pipeline {
+public:
+    ///> @brief fill item with the next input, return false at the end of input
+    using Source = std::function<bool(T& item)>;
+    using Stage  = std::function<void(T& item)>;
+
+    explicit Pipeline(Source source) : mSource(std::move(source)) {}
+    ~Pipeline() = default;
+
+    auto addStage(const StageMode mode, Stage func) -> Pipeline&;
+    auto stageCount() const -> std::size_t;
+    /**
+     * @brief run the pipeline on pool with at most maxTokens items in flight
+     *
+     * @return std::shared_ptr<TaskPromise> promise of the run, Done once the source ended and every item left the last
+     * stage, Cancelled if a cancel was requested on it (the source is not called any more, items in flight finish).
+     * nullptr if maxTokens is 0 or a run is still in flight.
+     */
+    auto run(ThreadPool& pool, const std::size_t maxTokens) -> std::shared_ptr<TaskPromise>;
+    /**
+     * @brief run the pipeline on executor, e.g. a StrandExecutor to keep all of it on one strand of a pool
+     * @note the executor must outlive the run. an inline executor carries every item in the calling thread, one after
+     * another from a loop, so a long input does not grow the stack.
+     */
+    template <LLWFLOWS_EXECUTOR E>
+    auto run(E& executor, const std::size_t maxTokens) -> std::shared_ptr<TaskPromise>;
+
+private:
+    Pipeline(const Pipeline&)                    = delete;
+    auto operator=(const Pipeline&) -> Pipeline& = delete;
+
+    struct Item {
+        T        value{};
+        uint64_t sequence{0};
+    };
+    struct StageState {
+        StageMode          mode;
+        Stage              func;
+        detail::SpinLock   lock;
+        bool               busy{false};
+        uint64_t           nextSequence{0};  ///> in order: sequence of the item allowed in next
+        std::vector<Item*> reorder;          ///> in order: waiting items by sequence % maxTokens
+        std::deque<Item*>  waiting;          ///> out of order: waiting items by arrival
+    };
+
+    using Execute = std::function<int(std::function<void()>)>;
+    ///> @brief tasks run in the calling thread by dispatch, instead of nested in the task which dispatched them
+    struct Trampoline {
+        Pipeline*                         owner{nullptr};
+        bool                              executing{false};  ///> inside mExecute, a task run now is inlined
+        std::deque<std::function<void()>> tasks;
+    };
+    static auto trampoline() -> Trampoline*&;
+
+    ///> @brief start a run whose tasks are given to execute
+    auto start(Execute execute, const std::size_t maxTokens) -> std::shared_ptr<TaskPromise>;
+    ///> @brief read one item from the source and carry it through the stages
+    auto pump() -> void;
+    auto schedulePump() -> void;
+    ///> @brief run item from stage on, held: item already owns the serial stage
+    auto process(Item* item, std::size_t stage, bool held) -> void;
+    auto acquire(StageState& stage, Item* item) -> bool;
+    ///> @brief leave the serial stage, return the waiting item which owns it now
+    auto release(StageState& stage) -> Item*;
+    auto takeItem() -> Item*;
+    auto hasFreeItem() -> bool;
+    auto giveItem(Item* item) -> void;
+    auto retire(Item* item) -> void;
+    auto finish() -> void;
+    template <typename F>
+    auto dispatch(F&& task) -> void;
+
+private:
+    Source                 mSource;
+    std::deque<StageState> mStages;
+    // state of the run in flight
+    Execute                      mExecute;
+    std::shared_ptr<TaskPromise> mRunPromise;
+    std::vector<Item>            mItems;
+    detail::SpinLock             mFreeLock;
+    std::vector<Item*>           mFree;
+    uint64_t                     mSequence{0};  ///> only touched by the pump, which never runs twice at once
+    std::atomic<bool>            mPumping{false};
+    std::atomic<bool>            mEnded{false};
+    std::atomic<bool>            mFinished{false};
+    std::atomic<int64_t>         mInFlight{0};
+};
+
+template <typename T>
+auto Pipeline<T>::addStage(const StageMode mode, Stage func) -> Pipeline& {
+    mStages.emplace_back();
+    mStages.back().mode = mode;
+    mStages.back().func = std::move(func);
+    return *this;
+}
+
+template <typename T>
+auto Pipeline<T>::stageCount() const -> std::size_t {
+    return mStages.size();
+}
+
+template <typename T>
+auto Pipeline<T>::run(ThreadPool& pool, const std::size_t maxTokens) -> std::shared_ptr<TaskPromise> {
+    return start([&pool](std::function<void()> task) { return pool.post(std::move(task)); }, maxTokens);
+}
+
+template <typename T>
+template <LLWFLOWS_EXECUTOR E>
+auto Pipeline<T>::run(E& executor, const std::size_t maxTokens) -> std::shared_ptr<TaskPromise> {
+    return start([&executor](std::function<void()> task) { return executor.execute(std::move(task)); }, maxTokens);
+}
+
+template <typename T>
+auto Pipeline<T>::start(Execute execute, const std::size_t maxTokens) -> std::shared_ptr<TaskPromise> {
+    if (maxTokens == 0) {
+        LLWFLOWS_LOG_ERROR("Pipeline needs at least one token.");
+        return nullptr;
+    }
+    if (mRunPromise != nullptr &&
+        (mRunPromise->state() == TaskState::Queuing || mRunPromise->state() == TaskState::Running)) {
+        LLWFLOWS_LOG_WARN("Pipeline is still running.");
+        return nullptr;
+    }
+    mExecute = std::move(execute);
+    if (mItems.size() != maxTokens) {
+        mItems = std::vector<Item>(maxTokens);
+    }
+    mFree.clear();
+    for (auto& item : mItems) {
+        mFree.push_back(&item);
+    }
+    for (auto& stage : mStages) {
+        stage.busy         = false;
+        stage.nextSequence = 0;
+        stage.reorder.assign(stage.mode == StageMode::SerialInOrder ? maxTokens : 0, nullptr);
+        stage.waiting.clear();
+    }
+    mSequence = 0;
+    mEnded.store(false);
+    mFinished.store(false);
+    mInFlight.store(0);
+    mRunPromise = std::make_shared<TaskPromise>();
+    mRunPromise->changeState(TaskState::Queuing, TaskState::Running);
+    auto promise = mRunPromise;
+    mPumping.store(true);
+    dispatch([this]() { pump(); });
+    return promise;
+}
+
+template <typename T>
+auto Pipeline<T>::pump() -> void {
+    auto item = takeItem();
+    if (item == nullptr) {
+        // all tokens in flight, the next retire starts the pump again.
+        mPumping.store(false);
+        if (hasFreeItem()) {
+            schedulePump();
+        }
+        return;
+    }
+    if (mRunPromise->isCancelRequested() || !mSource(item->value)) {
+        giveItem(item);
+        mEnded.store(true);
+        mPumping.store(false);
+        if (mInFlight.load() == 0) {
+            finish();
+        }
+        return;
+    }
+    item->sequence = mSequence++;
+    mInFlight.fetch_add(1);
+    // the next read overlaps with this item going down the stages.
+    mPumping.store(false);
+    schedulePump();
+    process(item, 0, false);
+}
+
+template <typename T>
+auto Pipeline<T>::schedulePump() -> void {
+    if (!mEnded.load() && !mPumping.exchange(true)) {
+        dispatch([this]() { pump(); });
+    }
+}
+
+template <typename T>
+auto Pipeline<T>::process(Item* item, std::size_t stage, bool held) -> void {
+    for (; stage < mStages.size(); ++stage) {
+        auto& state = mStages[stage];
+        if (state.mode != StageMode::Parallel && !held && !acquire(state, item)) {
+            // parked at the stage, whoever releases it carries the item on.
+            return;
+        }
+        held = false;
+        state.func(item->value);
+        if (state.mode != StageMode::Parallel) {
+            if (auto next = release(state); next != nullptr) {
+                dispatch([this, next, stage]() { process(next, stage, true); });
+            }
+        }
+    }
+    retire(item);
+}
+
+template <typename T>
+auto Pipeline<T>::acquire(StageState& stage, Item* item) -> bool {
+    std::lock_guard<detail::SpinLock> lock(stage.lock);
+    if (!stage.busy && (stage.mode == StageMode::SerialOutOfOrder || item->sequence == stage.nextSequence)) {
+        stage.busy = true;
+        return true;
+    }
+    if (stage.mode == StageMode::SerialInOrder) {
+        // every sequence between nextSequence and this one still holds a token, so the slot is free.
+        stage.reorder[item->sequence % stage.reorder.size()] = item;
+    } else {
+        stage.waiting.push_back(item);
+    }
+    return false;
+}
+
+template <typename T>
+auto Pipeline<T>::release(StageState& stage) -> Item* {
+    std::lock_guard<detail::SpinLock> lock(stage.lock);
+    Item*                             next = nullptr;
+    if (stage.mode == StageMode::SerialInOrder) {
+        auto& slot = stage.reorder[++stage.nextSequence % stage.reorder.size()];
+        std::swap(next, slot);
+    } else if (!stage.waiting.empty()) {
+        next = stage.waiting.front();
+        stage.waiting.pop_front();
+    }
+    stage.busy = next != nullptr;
+    return next;
+}
+
+template <typename T>
+auto Pipeline<T>::takeItem() -> Item* {
+    std::lock_guard<detail::SpinLock> lock(mFreeLock);
+    if (mFree.empty()) {
+        return nullptr;
+    }
+    auto item = mFree.back();
+    mFree.pop_back();
+    return item;
+}
+
+template <typename T>
+auto Pipeline<T>::hasFreeItem() -> bool {
+    std::lock_guard<detail::SpinLock> lock(mFreeLock);
+    return !mFree.empty();
+}
+
+template <typename T>
+auto Pipeline<T>::giveItem(Item* item) -> void {
+    std::lock_guard<detail::SpinLock> lock(mFreeLock);
+    mFree.push_back(item);
+}
+
+template <typename T>
+auto Pipeline<T>::retire(Item* item) -> void {
+    giveItem(item);
+    if (mInFlight.fetch_sub(1) == 1 && mEnded.load()) {
+        finish();
+        return;
+    }
+    schedulePump();
+}
+
+template <typename T>
+auto Pipeline<T>::finish() -> void {
+    // both the end of the source and the last retire may get here.
+    if (mFinished.exchange(true)) {
+        return;
+    }
+    auto promise = mRunPromise;
+    if (promise->isCancelRequested()) {
+        promise->changeState(TaskState::Running, TaskState::Cancelled);
+    } else {
+        promise->done();
+    }
+}
+
+template <typename T>
+auto Pipeline<T>::trampoline() -> Trampoline*& {
+    static thread_local Trampoline* current = nullptr;
+    return current;
+}
+
+template <typename T>
+template <typename F>
+auto Pipeline<T>::dispatch(F&& task) -> void {
+    // an executor which runs the task inside execute() or refuses it would nest a frame per item, such tasks go to the
+    // trampoline of this thread instead and the outermost dispatch runs them one after another.
+    auto&      current = trampoline();
+    auto       outer   = current;
+    auto       nested  = outer != nullptr && outer->owner == this;
+    Trampoline local;
+    local.owner = this;
+    auto loop   = nested ? outer : &local;
+    current     = loop;
+
+    std::function<void()> func(std::forward<F>(task));
+    auto                  executing = loop->executing;
+    loop->executing                 = true;
+    auto ret                        = mExecute([this, func]() {
+        auto running = trampoline();
+        if (running != nullptr && running->owner == this && running->executing) {
+            running->tasks.push_back(func);
+            return;
+        }
+        func();
+    });
+    loop->executing = executing;
+    if (ret != 0) {
+        // an item can not be dropped without stalling the run, run it here if the executor refuses it.
+        loop->tasks.push_back(std::move(func));
+    }
+    if (nested) {
+        return;
+    }
+    while (!local.tasks.empty()) {
+        auto next = std::move(local.tasks.front());
+        local.tasks.pop_front();
+        next();
+    }
+    current = outer;
+}
+
+LLWFLOWS_NS_END
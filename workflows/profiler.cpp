@@ -0,0 +1,245 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+LLWFLOWS_NS_BEGIN
+static auto toMs(const std::chrono::nanoseconds duration) -> double { return duration.count() / 1e6; }
+
+static auto toUs(const std::chrono::nanoseconds duration) -> double { return duration.count() / 1e3; }
+
+static auto labelOf(const Profiler::TaskRecord& record) -> std::string {
+    std::string label(record.name.empty() ? std::string_view("task") : record.name.view());
+    // the label is quoted in the dot output.
+    for (std::size_t pos = 0; (pos = label.find('"', pos)) != std::string::npos; pos += 2) {
+        label.insert(pos, 1, '\\');
+    }
+    return label;
+}
+
+auto Profiler::clear() -> void {
+    for (int i = 0; mLanes != nullptr && i <= mWorkerCount; ++i) {
+        std::lock_guard<detail::SpinLock> lock(mLanes[i].lock);
+        mLanes[i].tasks.clear();
+        mLanes[i].retries.clear();
+        mLanes[i].steals.clear();
+    }
+}
+
+auto Profiler::records() const -> std::vector<TaskRecord> {
+    std::vector<TaskRecord> records;
+    for (int i = 0; mLanes != nullptr && i <= mWorkerCount; ++i) {
+        std::lock_guard<detail::SpinLock> lock(mLanes[i].lock);
+        records.insert(records.end(), mLanes[i].tasks.begin(), mLanes[i].tasks.end());
+    }
+    std::stable_sort(records.begin(), records.end(),
+                     [](const TaskRecord& a, const TaskRecord& b) { return a.start < b.start; });
+    return records;
+}
+
+auto Profiler::analyze() const -> Report { return analyze(records()); }
+
+auto Profiler::analyze(const std::vector<TaskRecord>& records) const -> Report {
+    Report report;
+    report.workers.resize(mWorkerCount);
+    report.taskCount = static_cast<int>(records.size());
+    if (records.empty()) {
+        return report;
+    }
+    auto first = records.front().start;
+    auto last  = records.front().end;
+    for (auto& record : records) {
+        last = std::max(last, record.end);
+        report.totalWork += record.end - record.start;
+    }
+    report.wallTime = last - first;
+
+    // records are sorted by start, a dependency ended before its dependent started, so it is already visited.
+    std::unordered_map<uint64_t, std::size_t> index;
+    std::vector<std::chrono::nanoseconds>     longest(records.size());
+    std::vector<int64_t>                      previous(records.size(), -1);
+    std::size_t                               sink = 0;
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        for (auto dep : records[i].dependencies) {
+            auto iter = index.find(dep);
+            if (iter != index.end() && longest[iter->second] > longest[i]) {
+                longest[i]  = longest[iter->second];
+                previous[i] = static_cast<int64_t>(iter->second);
+            }
+        }
+        longest[i] += records[i].end - records[i].start;
+        if (records[i].taskId != 0) {
+            index[records[i].taskId] = i;
+        }
+        sink = longest[i] > longest[sink] ? i : sink;
+    }
+    report.criticalPathLength = longest[sink];
+    for (auto i = static_cast<int64_t>(sink); i != -1; i = previous[i]) {
+        report.criticalPath.push_back(records[i].taskId);
+    }
+    std::reverse(report.criticalPath.begin(), report.criticalPath.end());
+
+    std::vector<Clock::time_point> cursors(mWorkerCount, first);
+    for (auto& record : records) {
+        if (record.workerId < 0 || record.workerId >= mWorkerCount) {
+            continue;
+        }
+        auto& stats  = report.workers[record.workerId];
+        auto& cursor = cursors[record.workerId];
+        if (record.start > cursor) {
+            stats.idle += record.start - cursor;
+            stats.longestIdleGap = std::max<std::chrono::nanoseconds>(stats.longestIdleGap, record.start - cursor);
+            ++stats.idleGapCount;
+        }
+        cursor = std::max(cursor, record.end);
+        stats.busy += record.end - record.start;
+        ++stats.taskCount;
+    }
+    for (int i = 0; i < mWorkerCount; ++i) {
+        auto& stats = report.workers[i];
+        if (last > cursors[i]) {
+            stats.idle += last - cursors[i];
+            stats.longestIdleGap = std::max<std::chrono::nanoseconds>(stats.longestIdleGap, last - cursors[i]);
+            ++stats.idleGapCount;
+        }
+        stats.utilization = report.wallTime.count() > 0 ? static_cast<double>(stats.busy.count()) /
+                                                              static_cast<double>(report.wallTime.count())
+                                                        : 0.0;
+    }
+
+    // a retry is recorded by the failed attempt, the first one is when the task was first picked up.
+    std::unordered_map<uint64_t, Clock::time_point> firstAttempt;
+    for (int i = 0; mLanes != nullptr && i <= mWorkerCount; ++i) {
+        std::lock_guard<detail::SpinLock> lock(mLanes[i].lock);
+        for (auto& retry : mLanes[i].retries) {
+            auto iter = firstAttempt.find(retry.taskId);
+            if (iter == firstAttempt.end() || retry.time < iter->second) {
+                firstAttempt[retry.taskId] = retry.time;
+            }
+        }
+        report.retryCount += static_cast<int>(mLanes[i].retries.size());
+        for (auto& steal : mLanes[i].steals) {
+            if (i < mWorkerCount) {
+                ++report.workers[i].stealCount;
+                report.workers[i].stealTime += steal.end - steal.start;
+            }
+            ++report.stealCount;
+            report.stealTime += steal.end - steal.start;
+        }
+    }
+    for (auto& record : records) {
+        auto iter = record.taskId != 0 ? firstAttempt.find(record.taskId) : firstAttempt.end();
+        if (iter != firstAttempt.end() && record.start > iter->second) {
+            report.retryDelay += record.start - iter->second;
+        }
+    }
+
+    auto work = static_cast<double>(report.totalWork.count());
+    if (report.wallTime.count() > 0) {
+        report.speedup = work / static_cast<double>(report.wallTime.count());
+    }
+    auto bound = std::max(static_cast<double>(report.criticalPathLength.count()), work / std::max(mWorkerCount, 1));
+    if (bound > 0.0) {
+        report.idealSpeedup = work / bound;
+    }
+    return report;
+}
+
+auto Profiler::textReport() const -> std::string {
+    auto               records = this->records();
+    auto               report  = analyze(records);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "tasks              " << report.taskCount << " on " << mWorkerCount << " workers\n";
+    out << "wall time          " << toMs(report.wallTime) << " ms\n";
+    out << "total work         " << toMs(report.totalWork) << " ms\n";
+    out << "critical path      " << toMs(report.criticalPathLength) << " ms, " << report.criticalPath.size()
+        << " tasks\n";
+    out << std::setprecision(2);
+    out << "speedup            " << report.speedup << " (ideal " << report.idealSpeedup << ", efficiency "
+        << std::setprecision(0) << (report.idealSpeedup > 0.0 ? report.speedup / report.idealSpeedup * 100.0 : 0.0)
+        << "%)\n";
+    out << std::setprecision(3);
+    out << "dependency retries " << report.retryCount << ", " << toMs(report.retryDelay) << " ms delay\n";
+    out << "steals             " << report.stealCount << ", " << toMs(report.stealTime) << " ms\n";
+    out << "worker  tasks   busy ms   util  idle gaps  idle ms  longest gap ms  steals\n";
+    for (std::size_t i = 0; i < report.workers.size(); ++i) {
+        auto& stats = report.workers[i];
+        out << std::setw(6) << i << std::setw(7) << stats.taskCount << std::setw(10) << toMs(stats.busy)
+            << std::setw(6) << std::setprecision(0) << stats.utilization * 100.0 << "%" << std::setprecision(3)
+            << std::setw(11) << stats.idleGapCount << std::setw(9) << toMs(stats.idle) << std::setw(16)
+            << toMs(stats.longestIdleGap) << std::setw(8) << stats.stealCount << "\n";
+    }
+    std::unordered_map<uint64_t, const TaskRecord*> byId;
+    for (auto& record : records) {
+        byId[record.taskId] = &record;
+    }
+    out << "critical path:";
+    for (auto id : report.criticalPath) {
+        auto record = byId.at(id);
+        out << (id == report.criticalPath.front() ? " " : " -> ") << labelOf(*record) << "#" << id << " ("
+            << toUs(record->end - record->start) << " us)";
+    }
+    out << "\n";
+    return out.str();
+}
+
+auto Profiler::dot() const -> std::string {
+    auto               records = this->records();
+    auto               report  = analyze(records);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << "digraph workflow {\n    node [shape=box];\n";
+    std::unordered_map<uint64_t, std::size_t> index;
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        auto& record   = records[i];
+        auto  critical = record.taskId != 0 && std::find(report.criticalPath.begin(), report.criticalPath.end(),
+                                                        record.taskId) != report.criticalPath.end();
+        out << "    n" << i << " [label=\"" << labelOf(record) << "#" << record.taskId << "\\nworker "
+            << record.workerId << ", " << toUs(record.end - record.start) << " us\"" << (critical ? ", color=red" : "")
+            << "];\n";
+        for (auto dep : record.dependencies) {
+            if (auto iter = index.find(dep); iter != index.end()) {
+                out << "    n" << iter->second << " -> n" << i << ";\n";
+            }
+        }
+        if (record.taskId != 0) {
+            index[record.taskId] = i;
+        }
+    }
+    out << "}\n";
+    return out.str();
+}
+
+auto Profiler::attach(const int workerCount) -> void {
+    mWorkerCount = workerCount;
+    mLanes.reset(new Lane[workerCount + 1]);
+}
+
+auto Profiler::lane(const int workerId) -> Lane& {
+    return mLanes[workerId >= 0 && workerId < mWorkerCount ? workerId : mWorkerCount];
+}
+
+auto Profiler::recordTask(const int workerId, TaskRecord&& record) -> void {
+    record.workerId = workerId;
+    auto&                             lane = this->lane(workerId);
+    std::lock_guard<detail::SpinLock> lock(lane.lock);
+    lane.tasks.push_back(std::move(record));
+}
+
+auto Profiler::recordRetry(const int workerId, const uint64_t taskId) -> void {
+    auto&                             lane = this->lane(workerId);
+    std::lock_guard<detail::SpinLock> lock(lane.lock);
+    lane.retries.push_back(Retry{taskId, Clock::now()});
+}
+
+auto Profiler::recordSteal(const int workerId, const Clock::time_point start) -> void {
+    auto&                             lane = this->lane(workerId);
+    std::lock_guard<detail::SpinLock> lock(lane.lock);
+    lane.steals.push_back(Steal{start, Clock::now()});
+}
+
+LLWFLOWS_NS_END
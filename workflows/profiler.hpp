@@ -0,0 +1,113 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "detail/spinlock.hpp"
+#include "detail/workflowsglobal.hpp"
+#include "taskname.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief post-run profile of the tasks of a ThreadPool
+ *
+ * once set by ThreadPool::setProfiler(), every run of a task records its worker, start and end time and the ids of its
+ * dependencies, and every dependency retry and successful steal is counted. each worker writes to its own lane, so
+ * recording does not contend. after the workflow finished, analyze() derives from them the critical path realized by
+ * the durations, the utilization and idle gaps of every worker, the time lost to retries and steals, and the speedup
+ * against the ideal one. textReport() and dot() render it.
+ *
+ * @note
+ * a task is identified by the id of its promise, tasks added by post() have none and are not part of the edges.
+ * analyze while tasks are still running only sees the finished ones.
+ */
+class LLWFLOWS_API Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct TaskRecord {
+        uint64_t              taskId{0};
+        TaskName              name;
+        int                   workerId{-1};  ///> -1 if run by a thread outside the pool
+        Clock::time_point     start;
+        Clock::time_point     end;
+        int                   retryCount{0};
+        std::vector<uint64_t> dependencies;
+    };
+    struct WorkerStats {
+        int                      taskCount{0};
+        std::chrono::nanoseconds busy{0};
+        std::chrono::nanoseconds idle{0};  ///> inside the profiled window
+        int                      idleGapCount{0};
+        std::chrono::nanoseconds longestIdleGap{0};
+        int                      stealCount{0};
+        std::chrono::nanoseconds stealTime{0};  ///> spent in successful steals
+        double                   utilization{0.0};
+    };
+    struct Report {
+        int                      taskCount{0};
+        std::chrono::nanoseconds wallTime{0};  ///> from the first start to the last end
+        std::chrono::nanoseconds totalWork{0};
+        std::chrono::nanoseconds criticalPathLength{0};
+        std::vector<uint64_t>    criticalPath;  ///> task ids, from the source to the sink
+        int                      retryCount{0};
+        std::chrono::nanoseconds retryDelay{0};  ///> from the first attempt to the start, summed over retried tasks
+        int                      stealCount{0};
+        std::chrono::nanoseconds stealTime{0};
+        double                   speedup{0.0};       ///> total work over wall time
+        double                   idealSpeedup{0.0};  ///> bound by the worker count and the critical path
+        std::vector<WorkerStats> workers;
+    };
+
+    Profiler()  = default;
+    ~Profiler() = default;
+
+    ///> @brief drop all records, must not be called while the pool runs tasks
+    auto clear() -> void;
+    ///> @brief records of all lanes sorted by start time
+    auto records() const -> std::vector<TaskRecord>;
+    auto analyze() const -> Report;
+    auto textReport() const -> std::string;
+    ///> @brief graphviz graph of the tasks and their dependencies, labelled with durations, critical path in red
+    auto dot() const -> std::string;
+
+private:
+    friend class ThreadPool;
+
+    Profiler(const Profiler&)                    = delete;
+    auto operator=(const Profiler&) -> Profiler& = delete;
+
+    struct Retry {
+        uint64_t          taskId;
+        Clock::time_point time;
+    };
+    struct Steal {
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+    // one lane per worker and a last one for other threads.
+    struct alignas(64) Lane {
+        detail::SpinLock        lock;
+        std::vector<TaskRecord> tasks;
+        std::vector<Retry>      retries;
+        std::vector<Steal>      steals;
+    };
+
+    ///> @brief size the lanes for the workers of the pool
+    auto attach(const int workerCount) -> void;
+    auto lane(const int workerId) -> Lane&;
+    auto recordTask(const int workerId, TaskRecord&& record) -> void;
+    auto recordRetry(const int workerId, const uint64_t taskId) -> void;
+    auto recordSteal(const int workerId, const Clock::time_point start) -> void;
+    auto analyze(const std::vector<TaskRecord>& records) const -> Report;
+
+private:
+    int                     mWorkerCount{0};
+    std::unique_ptr<Lane[]> mLanes;
+};
+
+LLWFLOWS_NS_END
@@ -0,0 +1,60 @@
+#include "ratelimiter.hpp"
+
+#include <algorithm>
+
+#include "detail/log.hpp"
+
+LLWFLOWS_NS_BEGIN
+static auto toNs(const RateLimiter::Clock::time_point timePoint) -> int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint.time_since_epoch()).count();
+}
+
+RateLimiter::RateLimiter(const double ratePerSecond, const double burst)
+    : mRate(ratePerSecond),
+      mBurst(std::max(burst, 1.0)),
+      mInterval(ratePerSecond > 0.0 ? static_cast<int64_t>(1e9 / ratePerSecond) : 0),
+      mTolerance(static_cast<int64_t>((mBurst - 1.0) * static_cast<double>(mInterval))) {
+    if (ratePerSecond <= 0.0) {
+        LLWFLOWS_LOG_WARN("Rate limiter with rate {}/s does not limit.", ratePerSecond);
+    }
+}
+
+auto RateLimiter::create(const double ratePerSecond, const double burst) -> std::shared_ptr<RateLimiter> {
+    return std::make_shared<RateLimiter>(ratePerSecond, burst);
+}
+
+auto RateLimiter::tryAcquire(const Clock::time_point now) -> std::chrono::nanoseconds {
+    if (mInterval == 0) {
+        return std::chrono::nanoseconds::zero();
+    }
+    const auto current = toNs(now);
+    auto       next    = mNextToken.load(std::memory_order_relaxed);
+    while (true) {
+        // an idle bucket does not save more than burst tokens, the schedule restarts from now.
+        auto start = std::max(next, current);
+        if (start - current > mTolerance) {
+            mThrottled.fetch_add(1, std::memory_order_relaxed);
+            return std::chrono::nanoseconds(start - current - mTolerance);
+        }
+        if (mNextToken.compare_exchange_weak(next, start + mInterval, std::memory_order_acq_rel,
+                                             std::memory_order_relaxed)) {
+            return std::chrono::nanoseconds::zero();
+        }
+    }
+}
+
+auto RateLimiter::available(const Clock::time_point now) const -> double {
+    if (mInterval == 0) {
+        return mBurst;
+    }
+    auto ahead = std::max<int64_t>(mNextToken.load(std::memory_order_acquire) - toNs(now), 0);
+    return std::min(std::max(static_cast<double>(mTolerance + mInterval - ahead) / mInterval, 0.0), mBurst);
+}
+
+auto RateLimiter::rate() const -> double { return mRate; }
+
+auto RateLimiter::burst() const -> double { return mBurst; }
+
+auto RateLimiter::throttledCount() const -> uint64_t { return mThrottled.load(std::memory_order_relaxed); }
+
+LLWFLOWS_NS_END
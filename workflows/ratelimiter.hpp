@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "detail/workflowsglobal.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief token bucket shared by a class of tasks, see TaskDescription::rateLimiter
+ *
+ * the bucket holds at most burst tokens and is refilled at rate tokens per second. it is kept as the time the next
+ * token is due (GCRA), so taking a token is one CAS on one word, without lock nor refill thread.
+ *
+ * @note
+ * a rate which is not positive never limits.
+ */
+class LLWFLOWS_API RateLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit RateLimiter(const double ratePerSecond, const double burst = 1.0);
+    ~RateLimiter() = default;
+    static auto create(const double ratePerSecond, const double burst = 1.0) -> std::shared_ptr<RateLimiter>;
+
+    /**
+     * @brief take a token if one is available at now
+     *
+     * @return std::chrono::nanoseconds 0 if taken, otherwise how long until the next token
+     */
+    auto tryAcquire(const Clock::time_point now = Clock::now()) -> std::chrono::nanoseconds;
+    ///> @brief tokens left in the bucket at now
+    auto available(const Clock::time_point now = Clock::now()) const -> double;
+    auto rate() const -> double;
+    auto burst() const -> double;
+    ///> @brief count of acquires refused for lack of token
+    auto throttledCount() const -> uint64_t;
+
+private:
+    RateLimiter(const RateLimiter&)                    = delete;
+    auto operator=(const RateLimiter&) -> RateLimiter& = delete;
+
+private:
+    const double          mRate;
+    const double          mBurst;
+    const int64_t         mInterval;   ///> ns between two tokens
+    const int64_t         mTolerance;  ///> ns the schedule may run ahead of now, (burst - 1) tokens
+    std::atomic<int64_t>  mNextToken{0};  ///> steady clock ns of the next token if taken at the rate, full if past
+    std::atomic<uint64_t> mThrottled{0};
+};
+
+LLWFLOWS_NS_END
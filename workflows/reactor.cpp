@@ -0,0 +1,159 @@
+#include "reactor.hpp"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "detail/log.hpp"
+#include "threadpools.hpp"
+
+LLWFLOWS_NS_BEGIN
+Reactor::Reactor(ThreadPool& pool) : mPool(pool) {
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mEpollFd < 0 || mWakeFd < 0) {
+        LLWFLOWS_LOG_ERROR("Reactor create epoll or eventfd failed: {}", std::strerror(errno));
+        return;
+    }
+    epoll_event event{};
+    event.events  = EPOLLIN;
+    event.data.fd = mWakeFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event);
+}
+
+Reactor::~Reactor() {
+    stop();
+    if (mWakeFd >= 0) {
+        close(mWakeFd);
+    }
+    if (mEpollFd >= 0) {
+        close(mEpollFd);
+    }
+}
+
+auto Reactor::watch(const int fd, const uint32_t events, Callback callback) -> int {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto                        iter = mWatches.find(fd);
+    if (iter != mWatches.end() && iter->second.armed) {
+        LLWFLOWS_LOG_WARN("Reactor fd {} is already watched.", fd);
+        return -1;
+    }
+    epoll_event event{};
+    // one shot, the fd stays registered but disarmed after firing, so the next watch only modifies it.
+    event.events  = events | EPOLLONESHOT;
+    event.data.fd = fd;
+    if (epoll_ctl(mEpollFd, iter == mWatches.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) != 0) {
+        LLWFLOWS_LOG_ERROR("Reactor watch fd {} failed: {}", fd, std::strerror(errno));
+        return -1;
+    }
+    auto& watch    = mWatches[fd];
+    watch.callback = std::move(callback);
+    watch.armed    = true;
+    if (!mExternal && !mThread.isJoinable()) {
+        mExit.store(false, std::memory_order_release);
+        mThread.setName("Reactor");
+        mThread.start(std::bind(&Reactor::run, this));
+    }
+    return 0;
+}
+
+auto Reactor::unwatch(const int fd) -> int {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mWatches.erase(fd) == 0) {
+        return -1;
+    }
+    // the fd may already be closed, which removed it from epoll by itself.
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    return 0;
+}
+
+auto Reactor::watchCount() -> std::size_t {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::size_t                 count = 0;
+    for (auto& [fd, watch] : mWatches) {
+        count += watch.armed;
+    }
+    return count;
+}
+
+auto Reactor::fd() -> int {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mThread.isJoinable()) {
+        LLWFLOWS_LOG_ERROR("Reactor is run by its own thread, it can not be driven by an external loop.");
+        return -1;
+    }
+    mExternal = true;
+    return mEpollFd;
+}
+
+auto Reactor::poll(const int timeoutMs) -> int {
+    epoll_event events[kMaxEventsPerPoll];
+    auto        count = epoll_wait(mEpollFd, events, kMaxEventsPerPoll, timeoutMs);
+    if (count < 0) {
+        if (errno != EINTR) {
+            LLWFLOWS_LOG_ERROR("Reactor epoll wait failed: {}", std::strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+    int fired = 0;
+    for (int i = 0; i < count; ++i) {
+        auto fd = events[i].data.fd;
+        if (fd == mWakeFd) {
+            uint64_t value;
+            while (read(mWakeFd, &value, sizeof(value)) > 0) {
+            }
+            continue;
+        }
+        Callback callback;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto                        iter = mWatches.find(fd);
+            if (iter == mWatches.end() || !iter->second.armed) {
+                continue;
+            }
+            iter->second.armed = false;
+            callback           = std::move(iter->second.callback);
+        }
+        auto ready = events[i].events;
+        if (mPool.post([callback = std::move(callback), ready]() { callback(ready); }) != 0) {
+            LLWFLOWS_LOG_WARN("Reactor callback of fd {} dropped, the pool refused it.", fd);
+            continue;
+        }
+        ++fired;
+    }
+    return fired;
+}
+
+auto Reactor::stop() -> void {
+    mExit.store(true, std::memory_order_release);
+    wakeUp();
+    if (mThread.isJoinable()) {
+        mThread.join();
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& [fd, watch] : mWatches) {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    mWatches.clear();
+}
+
+auto Reactor::run() -> void {
+    while (!mExit.load(std::memory_order_acquire)) {
+        poll(-1);
+    }
+}
+
+auto Reactor::wakeUp() -> void {
+    uint64_t value = 1;
+    if (mWakeFd >= 0 && write(mWakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        LLWFLOWS_LOG_ERROR("Reactor wake up failed: {}", std::strerror(errno));
+    }
+}
+
+LLWFLOWS_NS_END
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#ifdef __linux__
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include "detail/workflowsglobal.hpp"
+#include "thread.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+class ThreadPool;
+
+/**
+ * @brief epoll reactor of a ThreadPool
+ *
+ * a task registers interest in an fd with watch(), when the fd is ready the callback is added to the pool as a new
+ * task, so no worker is blocked while waiting for it. a watch fires once, call watch() again for the next event, e.g.
+ * from the callback itself.
+ *
+ * the reactor is run by its own thread, started by the first watch(). an external event loop can drive it instead:
+ * take fd() before the first watch(), add it to the loop, and call poll(0) every time it is readable.
+ *
+ * @note
+ * unwatch() an fd before closing it, epoll keeps watching the open file as long as any duplicate of the fd lives.
+ */
+class LLWFLOWS_API Reactor {
+public:
+    ///> ready events (EPOLLIN, EPOLLOUT, EPOLLHUP, ...) of the fd
+    using Callback = std::function<void(const uint32_t events)>;
+
+    explicit Reactor(ThreadPool& pool);
+    ~Reactor();
+
+    /**
+     * @brief run callback in the pool once fd has any of events (EPOLLIN, EPOLLOUT, ...)
+     *
+     * @return int -1 if fd is already watched and has not fired yet, or epoll refused it.
+     */
+    auto watch(const int fd, const uint32_t events, Callback callback) -> int;
+    ///> @brief stop watching fd, the callback is dropped if it has not fired yet
+    auto unwatch(const int fd) -> int;
+    ///> @brief count of fds waiting to fire
+    auto watchCount() -> std::size_t;
+    /**
+     * @brief epoll fd of the reactor, readable when any watched fd is ready
+     *
+     * @note taking it hands the reactor to an external event loop, its own thread is never started then.
+     * @return int -1 if the reactor thread is already running.
+     */
+    auto fd() -> int;
+    /**
+     * @brief wait up to timeoutMs (-1 forever) for ready fds and add their callbacks to the pool
+     *
+     * @return int count of callbacks added, -1 on error
+     */
+    auto poll(const int timeoutMs) -> int;
+    ///> @brief stop the reactor thread, callbacks not fired yet are dropped
+    auto stop() -> void;
+
+    static constexpr int kMaxEventsPerPoll = 64;
+
+private:
+    Reactor(const Reactor&)                    = delete;
+    auto operator=(const Reactor&) -> Reactor& = delete;
+
+    struct Watch {
+        Callback callback;
+        bool     armed{false};
+    };
+
+    auto run() -> void;
+    auto wakeUp() -> void;
+
+private:
+    ThreadPool&                    mPool;
+    int                            mEpollFd{-1};
+    int                            mWakeFd{-1};  ///> eventfd to interrupt epoll_wait
+    std::mutex                     mMutex;
+    std::unordered_map<int, Watch> mWatches;
+    Thread                         mThread;
+    bool                           mExternal{false};
+    std::atomic<bool>              mExit{false};
+};
+
+LLWFLOWS_NS_END
+#endif
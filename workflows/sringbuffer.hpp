@@ -5,13 +5,45 @@
 
 #include "detail/MPMCQueue.h"
 #include "detail/log.hpp"
+#include "detail/mpscqueue.hpp"
+#include "detail/spscqueue.hpp"
 #include "detail/workflowsglobal.hpp"
 
 LLWFLOWS_NS_BEGIN
 
-template <typename T>
+/**
+ * @brief access pattern of SRingBuffer, pick the cheapest one that the users satisfy.
+ *
+ * SPSC: one pusher and one popper, no read-modify-write on either side.
+ * MPSC: any pusher and one popper, CAS for push only.
+ * MPMC: any pusher and any popper, CAS on both sides.
+ */
+namespace policy {
+struct SPSC {
+    static constexpr bool kMultiProducer = false;
+    static constexpr bool kMultiConsumer = false;
+    template <typename T>
+    using Queue = detail::SPSCQueue<T>;
+};
+struct MPSC {
+    static constexpr bool kMultiProducer = true;
+    static constexpr bool kMultiConsumer = false;
+    template <typename T>
+    using Queue = detail::MPSCQueue<T>;
+};
+struct MPMC {
+    static constexpr bool kMultiProducer = true;
+    static constexpr bool kMultiConsumer = true;
+    template <typename T>
+    using Queue = rigtorp::mpmc::Queue<T>;
+};
+}  // namespace policy
+
+template <typename T, typename Policy = policy::MPMC>
 class SRingBuffer {
 public:
+    using PolicyType = Policy;
+
     SRingBuffer(std::size_t size);
     ~SRingBuffer();
     bool push(T&& item);
@@ -19,52 +51,72 @@ public:
     template <typename... Args>
     bool        emplace(Args&&... args);
     bool        pop(T& item);
+    /**
+     * @brief push up to count items moved from items, claiming the whole range of slots with one atomic operation.
+     * @return the number of leading items pushed, the rest are left untouched.
+     */
+    std::size_t try_push_n(T* items, std::size_t count);
+    /**
+     * @brief pop up to count items into items, claiming the whole range of slots with one atomic operation.
+     * @return the number of items popped.
+     */
+    std::size_t try_pop_n(T* items, std::size_t count);
     bool        empty() const;
     std::size_t size() const;
     std::size_t capacity() const;
 
 private:
-    rigtorp::mpmc::Queue<T> mQueue;
+    typename Policy::template Queue<T> mQueue;
 };
 
-template <typename T>
-SRingBuffer<T>::SRingBuffer(std::size_t size) : mQueue(size) {}
+template <typename T, typename Policy>
+SRingBuffer<T, Policy>::SRingBuffer(std::size_t size) : mQueue(size) {}
 
-template <typename T>
-SRingBuffer<T>::~SRingBuffer() {}
+template <typename T, typename Policy>
+SRingBuffer<T, Policy>::~SRingBuffer() {}
 
-template <typename T>
+template <typename T, typename Policy>
 template <typename... Args>
-inline bool SRingBuffer<T>::emplace(Args&&... args) {
+inline bool SRingBuffer<T, Policy>::emplace(Args&&... args) {
     return mQueue.try_emplace(std::forward<Args>(args)...);
 }
 
-template <typename T>
-bool SRingBuffer<T>::push(T&& item) {
+template <typename T, typename Policy>
+bool SRingBuffer<T, Policy>::push(T&& item) {
     return mQueue.try_emplace(std::forward<T>(item));
 }
-template <typename T>
-bool SRingBuffer<T>::push(const T& item) {
+template <typename T, typename Policy>
+bool SRingBuffer<T, Policy>::push(const T& item) {
     return mQueue.try_emplace(item);
 }
 
-template <typename T>
-bool SRingBuffer<T>::pop(T& item) {
+template <typename T, typename Policy>
+bool SRingBuffer<T, Policy>::pop(T& item) {
     return mQueue.try_pop(item);
 }
 
-template <typename T>
-inline bool SRingBuffer<T>::empty() const {
+template <typename T, typename Policy>
+inline std::size_t SRingBuffer<T, Policy>::try_push_n(T* items, std::size_t count) {
+    return mQueue.try_push_n(items, count);
+}
+
+template <typename T, typename Policy>
+inline std::size_t SRingBuffer<T, Policy>::try_pop_n(T* items, std::size_t count) {
+    return mQueue.try_pop_n(items, count);
+}
+
+template <typename T, typename Policy>
+inline bool SRingBuffer<T, Policy>::empty() const {
     return mQueue.empty();
 }
 
-template <typename T>
-inline std::size_t SRingBuffer<T>::size() const {
+template <typename T, typename Policy>
+inline std::size_t SRingBuffer<T, Policy>::size() const {
     return mQueue.size();
 }
 
-template <typename T>
-inline std::size_t SRingBuffer<T>::capacity() const {
+template <typename T, typename Policy>
+inline std::size_t SRingBuffer<T, Policy>::capacity() const {
     return mQueue.capacity();
 }
 LLWFLOWS_NS_END
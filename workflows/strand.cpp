@@ -0,0 +1,120 @@
+#include "strand.hpp"
+
+#include <cstdint>
+#include <thread>
+
+#include "detail/log.hpp"
+
+LLWFLOWS_NS_BEGIN
+static thread_local const void* kCurrentStrand = nullptr;
+
+Strand::Strand(ThreadPool& pool) : mCore(std::make_shared<Core>(pool)) {}
+
+auto Strand::post(std::function<void()> task) -> int {
+    auto node  = new Node();
+    node->func = std::move(task);
+    mCore->push(node);
+    // only the poster which raise the flag hands the queue to the pool, the others ride on that drain.
+    if (!mCore->scheduled.exchange(true, std::memory_order_seq_cst)) {
+        return mCore->schedule();
+    }
+    return 0;
+}
+
+auto Strand::runningInThisThread() const -> bool { return kCurrentStrand == mCore.get(); }
+
+auto Strand::pool() const -> ThreadPool& { return mCore->pool; }
+
+Strand::Core::Core(ThreadPool& pool) : pool(pool), tail(&stub), head(&stub) {}
+
+Strand::Core::~Core() {
+    while (auto node = pop()) {
+        delete node;
+    }
+}
+
+auto Strand::Core::push(Node* node) -> void {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    auto prev = tail.exchange(node, std::memory_order_acq_rel);
+    // between the exchange and this store the queue looks empty from the head, pop() returns nullptr meanwhile.
+    prev->next.store(node, std::memory_order_release);
+}
+
+auto Strand::Core::pop() -> Node* {
+    Node* first = head;
+    Node* next  = first->next.load(std::memory_order_acquire);
+    if (first == &stub) {
+        if (next == nullptr) {
+            return nullptr;
+        }
+        head  = next;
+        first = next;
+        next  = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+        head = next;
+        return first;
+    }
+    if (first != tail.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    // first is the last node, put the stub behind it so first can be unlinked.
+    push(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+        head = next;
+        return first;
+    }
+    return nullptr;
+}
+
+auto Strand::Core::empty() const -> bool { return head == &stub && tail.load(std::memory_order_seq_cst) == &stub; }
+
+auto Strand::Core::schedule(const bool yield) -> int {
+    TaskDescription desc;
+    // the drains of one strand prefer the same worker, so the data of the entity stays in its cache.
+    desc.affinityKey = reinterpret_cast<uintptr_t>(this);
+    desc.spawnLocal  = !yield;
+    auto promise     = pool.addTask(DrainRunner{shared_from_this()}, std::move(desc));
+    // a stopping pool returns the drain already cancelled, it will not run either.
+    if (promise == nullptr || promise->state() == TaskState::Cancelled) {
+        LLWFLOWS_LOG_WARN("Strand schedule drain task failed, tasks are left until next post.");
+        scheduled.store(false, std::memory_order_seq_cst);
+        return -1;
+    }
+    return 0;
+}
+
+auto Strand::Core::dropped() -> void { scheduled.store(false, std::memory_order_seq_cst); }
+
+auto Strand::Core::drain() -> void {
+    auto lastStrand = kCurrentStrand;
+    kCurrentStrand  = this;
+    int count       = 0;
+    while (count < kMaxDrainCount) {
+        if (auto node = pop(); node != nullptr) {
+            node->func();
+            delete node;
+            ++count;
+            continue;
+        }
+        if (!empty()) {
+            // a poster is between its exchange and link, it is about to be visible.
+            std::this_thread::yield();
+            continue;
+        }
+        scheduled.store(false, std::memory_order_seq_cst);
+        // a poster which saw the flag still raised before the store above left its task to this drain.
+        // only tail is read here, head belongs to the next drain as soon as the flag is dropped.
+        if (tail.load(std::memory_order_seq_cst) == &stub || scheduled.exchange(true, std::memory_order_seq_cst)) {
+            kCurrentStrand = lastStrand;
+            return;
+        }
+    }
+    kCurrentStrand = lastStrand;
+    // budget used up, queue the rest behind the other tasks of the pool instead of holding the worker. the local queue
+    // of the worker would run it next.
+    schedule(true);
+}
+
+LLWFLOWS_NS_END
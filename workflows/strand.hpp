@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "threadpools.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief serial executor on top of a ThreadPool
+ *
+ * tasks posted to one strand run in FIFO order and never concurrently, on whichever worker is free. a strand is only a
+ * lock-free queue and an atomic scheduled flag, it holds no thread and occupies no worker while it has nothing to do,
+ * so millions of them (e.g. one per account) are cheap.
+ *
+ * @note
+ * the pool must outlive the strand. copies of a strand share the same queue.
+ * the pool sees one task per drain instead of one per posted task, so there is no promise for a posted task.
+ */
+class LLWFLOWS_API Strand {
+public:
+    explicit Strand(ThreadPool& pool);
+    ~Strand() = default;
+
+    /**
+     * @brief queue task to run after all tasks posted to this strand before it
+     *
+     * @return int 0 on success, -1 if the pool refused the drain task. the task is still queued in that case and runs
+     * with the next successful post.
+     */
+    auto post(std::function<void()> task) -> int;
+    ///> @brief whether the calling thread is running a task of this strand
+    auto runningInThisThread() const -> bool;
+    auto pool() const -> ThreadPool&;
+
+    ///> @brief max tasks run by one drain before it yields the worker to other tasks
+    static constexpr int kMaxDrainCount = 64;
+
+private:
+    friend class ThreadPool;
+
+    struct Node {
+        std::atomic<Node*>    next{nullptr};
+        std::function<void()> func;
+    };
+    // intrusive multiple producer single consumer queue, the consumer is whoever holds the scheduled flag.
+    struct Core : std::enable_shared_from_this<Core> {
+        explicit Core(ThreadPool& pool);
+        ~Core();
+
+        auto push(Node* node) -> void;
+        auto pop() -> Node*;
+        auto empty() const -> bool;
+        ///> @brief hand the queue to the pool, yield: queue the drain behind the tasks already queued on the worker
+        auto schedule(const bool yield = false) -> int;
+        auto drain() -> void;
+        ///> @brief the pool dropped the drain task (e.g. it is stopping), the next post schedules a new one
+        auto dropped() -> void;
+
+        ThreadPool&        pool;
+        std::atomic<Node*> tail;
+        Node*              head;
+        Node               stub;
+        std::atomic<bool>  scheduled{false};
+    };
+
+    // what the pool runs for a drain, named so a drain dropped by the pool can be recognized
+    struct DrainRunner {
+        std::shared_ptr<Core> core;
+        auto                  operator()() -> void { core->drain(); }
+    };
+
+    std::shared_ptr<Core> mCore;
+};
+
+LLWFLOWS_NS_END
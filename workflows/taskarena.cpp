@@ -0,0 +1,75 @@
+#include "taskarena.hpp"
+
+#include <cstdint>
+#include <mutex>
+
+LLWFLOWS_NS_BEGIN
+// threads take lanes in turn, so up to kLaneCount threads never share a lane.
+static std::atomic<unsigned> kNextLane{0};
+static thread_local unsigned kLane = kNextLane.fetch_add(1, std::memory_order_relaxed) % TaskArena::kLaneCount;
+
+TaskArena::TaskArena(const std::size_t chunkSize) : mChunkSize(chunkSize), mLanes(new Lane[kLaneCount]) {}
+
+TaskArena::~TaskArena() {
+    for (int i = 0; i < kLaneCount; ++i) {
+        auto chunk = mLanes[i].chunks;
+        while (chunk != nullptr) {
+            auto next = chunk->next;
+            ::operator delete(chunk);
+            chunk = next;
+        }
+    }
+}
+
+auto TaskArena::create(const std::size_t chunkSize) -> std::shared_ptr<TaskArena> {
+    return std::make_shared<TaskArena>(chunkSize);
+}
+
+auto TaskArena::allocate(const std::size_t size, const std::size_t alignment) -> void* {
+    auto&                             lane = mLanes[kLane];
+    std::lock_guard<detail::SpinLock> lock(lane.lock);
+    auto address = (reinterpret_cast<std::uintptr_t>(lane.cursor) + alignment - 1) & ~(alignment - 1);
+    if (lane.cursor == nullptr || address + size > reinterpret_cast<std::uintptr_t>(lane.end)) {
+        // a big block gets a chunk of its own, so the current chunk of the lane is not thrown away for it.
+        if (size + alignment > mChunkSize / 4) {
+            auto chunk = newChunk(lane, sizeof(Chunk) + size + alignment);
+            address    = (reinterpret_cast<std::uintptr_t>(chunk + 1) + alignment - 1) & ~(alignment - 1);
+            lane.allocatedBytes.store(lane.allocatedBytes.load(std::memory_order_relaxed) + size,
+                                      std::memory_order_relaxed);
+            return reinterpret_cast<void*>(address);
+        }
+        auto chunk  = newChunk(lane, mChunkSize);
+        lane.cursor = reinterpret_cast<char*>(chunk + 1);
+        lane.end    = reinterpret_cast<char*>(chunk) + mChunkSize;
+        address     = (reinterpret_cast<std::uintptr_t>(lane.cursor) + alignment - 1) & ~(alignment - 1);
+    }
+    lane.cursor = reinterpret_cast<char*>(address + size);
+    lane.allocatedBytes.store(lane.allocatedBytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+    return reinterpret_cast<void*>(address);
+}
+
+auto TaskArena::allocatedBytes() const -> std::size_t {
+    std::size_t bytes = 0;
+    for (int i = 0; i < kLaneCount; ++i) {
+        bytes += mLanes[i].allocatedBytes.load(std::memory_order_relaxed);
+    }
+    return bytes;
+}
+
+auto TaskArena::chunkCount() const -> std::size_t {
+    std::size_t count = 0;
+    for (int i = 0; i < kLaneCount; ++i) {
+        count += mLanes[i].chunkCount.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+auto TaskArena::newChunk(Lane& lane, const std::size_t size) -> Chunk* {
+    auto chunk  = static_cast<Chunk*>(::operator new(size));
+    chunk->next = lane.chunks;
+    lane.chunks = chunk;
+    lane.chunkCount.store(lane.chunkCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return chunk;
+}
+
+LLWFLOWS_NS_END
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "detail/spinlock.hpp"
+#include "detail/workflowsglobal.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief monotonic memory of one workflow run
+ *
+ * scheduler metadata of a run (descriptions, their control blocks and promises) is bump allocated from chunks of the
+ * lane of the allocating thread, deallocate does nothing, and all chunks are released in one shot when the last
+ * reference to the arena is gone. so workers never free each other's objects through the global heap.
+ *
+ * @note
+ * every object allocated by ArenaAllocator holds a reference to the arena, the arena lives until the run is finished
+ * and all its promises are dropped.
+ */
+class LLWFLOWS_API TaskArena {
+public:
+    static constexpr std::size_t kDefaultChunkSize = 64 * 1024;
+    static constexpr int         kLaneCount        = 64;
+
+    explicit TaskArena(const std::size_t chunkSize = kDefaultChunkSize);
+    ~TaskArena();
+    static auto create(const std::size_t chunkSize = kDefaultChunkSize) -> std::shared_ptr<TaskArena>;
+
+    auto allocate(const std::size_t size, const std::size_t alignment = alignof(std::max_align_t)) -> void*;
+    ///> @brief bytes handed out, not counting the unused tail of chunks
+    auto allocatedBytes() const -> std::size_t;
+    auto chunkCount() const -> std::size_t;
+
+private:
+    TaskArena(const TaskArena&)                    = delete;
+    auto operator=(const TaskArena&) -> TaskArena& = delete;
+
+    struct Chunk {
+        Chunk* next;
+    };
+    // counters are per lane too, a shared counter would be the contention the arena is here to remove.
+    struct alignas(64) Lane {
+        detail::SpinLock         lock;
+        Chunk*                   chunks{nullptr};
+        char*                    cursor{nullptr};
+        char*                    end{nullptr};
+        std::atomic<std::size_t> allocatedBytes{0};
+        std::atomic<std::size_t> chunkCount{0};
+    };
+
+    auto newChunk(Lane& lane, const std::size_t size) -> Chunk*;
+
+private:
+    const std::size_t       mChunkSize;
+    std::unique_ptr<Lane[]> mLanes;
+};
+
+/**
+ * @brief std allocator drawing from a TaskArena, it keeps the arena alive
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(std::shared_ptr<TaskArena> arena) noexcept : mArena(std::move(arena)) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : mArena(other.arena()) {}
+
+    inline auto allocate(const std::size_t n) -> T* {
+        return static_cast<T*>(mArena->allocate(n * sizeof(T), alignof(T)));
+    }
+    inline auto deallocate(T*, const std::size_t) noexcept -> void {}
+    inline auto arena() const noexcept -> const std::shared_ptr<TaskArena>& { return mArena; }
+
+    template <typename U>
+    inline auto operator==(const ArenaAllocator<U>& other) const noexcept -> bool {
+        return mArena == other.arena();
+    }
+    template <typename U>
+    inline auto operator!=(const ArenaAllocator<U>& other) const noexcept -> bool {
+        return mArena != other.arena();
+    }
+
+private:
+    std::shared_ptr<TaskArena> mArena;
+};
+
+LLWFLOWS_NS_END
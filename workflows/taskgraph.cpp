@@ -0,0 +1,312 @@
+#include "taskgraph.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+#include "detail/log.hpp"
+
+LLWFLOWS_NS_BEGIN
+// weight of the newest run in the moving average of measured cost.
+static constexpr double kCostSmoothing = 0.3;
+
+static auto readyLess(const std::pair<double, int>& a, const std::pair<double, int>& b) -> bool {
+    // equal priority, the node added first goes first.
+    return a.first < b.first || (a.first == b.first && a.second > b.second);
+}
+
+auto TaskGraph::addNode(std::function<void()> func, const TaskName& name, const double cost) -> NodeId {
+    mNodes.emplace_back();
+    auto& node = mNodes.back();
+    node.func  = std::move(func);
+    node.name  = name;
+    node.cost  = cost;
+    return static_cast<NodeId>(mNodes.size() - 1);
+}
+
+auto TaskGraph::addCondition(std::function<int()> func, const TaskName& name, const double cost) -> NodeId {
+    mNodes.emplace_back();
+    auto& node     = mNodes.back();
+    node.condition = std::move(func);
+    node.name      = name;
+    node.cost      = cost;
+    return static_cast<NodeId>(mNodes.size() - 1);
+}
+
+auto TaskGraph::addSubflow(Subflow func, const TaskName& name, const double cost) -> NodeId {
+    mNodes.emplace_back();
+    auto& node   = mNodes.back();
+    node.subflow = std::move(func);
+    node.name    = name;
+    node.cost    = cost;
+    return static_cast<NodeId>(mNodes.size() - 1);
+}
+
+auto TaskGraph::addEdge(const NodeId from, const NodeId to) -> int {
+    // a condition node may select itself to loop on its own.
+    if (!isValid(from) || !isValid(to) || (from == to && mNodes[from].condition == nullptr)) {
+        LLWFLOWS_LOG_ERROR("Invalid edge {} -> {}", from, to);
+        return -1;
+    }
+    mNodes[from].successors.push_back(to);
+    if (mNodes[from].condition != nullptr) {
+        ++mNodes[to].weakPredecessorCount;
+    } else {
+        ++mNodes[to].predecessorCount;
+    }
+    return 0;
+}
+
+auto TaskGraph::setCost(const NodeId node, const double cost) -> int {
+    if (!isValid(node)) {
+        return -1;
+    }
+    mNodes[node].cost = cost;
+    return 0;
+}
+
+auto TaskGraph::setSchedule(const GraphSchedule schedule) -> void { mSchedule = schedule; }
+
+auto TaskGraph::useMeasuredCost(const bool enable) -> void { mUseMeasuredCost = enable; }
+
+auto TaskGraph::run(ThreadPool& pool, std::shared_ptr<TaskArena> arena) -> std::shared_ptr<TaskPromise> {
+    return start(&pool, nullptr, std::move(arena));
+}
+
+auto TaskGraph::start(ThreadPool* pool, Execute execute, std::shared_ptr<TaskArena> arena)
+    -> std::shared_ptr<TaskPromise> {
+    if (mRunPromise != nullptr &&
+        (mRunPromise->state() == TaskState::Queuing || mRunPromise->state() == TaskState::Running)) {
+        LLWFLOWS_LOG_WARN("Task graph is still running.");
+        return nullptr;
+    }
+    if (computeBottomLevels() != 0) {
+        LLWFLOWS_LOG_ERROR("Task graph has a cycle.");
+        return nullptr;
+    }
+    auto isSource = [](const Node& node) { return node.predecessorCount == 0 && node.weakPredecessorCount == 0; };
+    if (!mNodes.empty() && std::none_of(mNodes.begin(), mNodes.end(), isSource)) {
+        LLWFLOWS_LOG_ERROR("Task graph has no source node.");
+        return nullptr;
+    }
+    mPool       = pool;
+    mExecute    = std::move(execute);
+    mArena      = std::move(arena);
+    mRunPromise = mArena == nullptr ? std::make_shared<TaskPromise>()
+                                    : std::allocate_shared<TaskPromise>(ArenaAllocator<TaskPromise>(mArena));
+    mRunPromise->changeState(TaskState::Queuing, TaskState::Running);
+    // the parent node is in flight until this run ends, so its run promise is still the current one.
+    if (mParent != nullptr && mParent->mRunPromise->addDependent(mRunPromise) != 0) {
+        mRunPromise->requestCancel(false);
+    }
+    auto promise = mRunPromise;
+    if (mNodes.empty()) {
+        promise->done();
+        return promise;
+    }
+    mReadySequence = 0;
+    mReady.clear();
+    int sourceCount = 0;
+    {
+        // all sources are in the heap before the first slot starts, so it picks among all of them.
+        std::lock_guard<detail::SpinLock> lock(mReadyLock);
+        for (NodeId i = 0; i < static_cast<NodeId>(mNodes.size()); ++i) {
+            mNodes[i].pending.store(mNodes[i].predecessorCount, std::memory_order_relaxed);
+            if (isSource(mNodes[i])) {
+                pushReady(i);
+                ++sourceCount;
+            }
+        }
+    }
+    mInFlight.store(sourceCount, std::memory_order_relaxed);
+    for (int i = 0; i < sourceCount; ++i) {
+        submitSlot();
+    }
+    return promise;
+}
+
+auto TaskGraph::nodeCount() const -> int { return static_cast<int>(mNodes.size()); }
+
+auto TaskGraph::name(const NodeId node) const -> TaskName { return isValid(node) ? mNodes[node].name : TaskName(); }
+
+auto TaskGraph::bottomLevel(const NodeId node) const -> double {
+    return isValid(node) ? mNodes[node].bottomLevel : 0.0;
+}
+
+auto TaskGraph::criticalPathLength() const -> double { return mCriticalPathLength; }
+
+auto TaskGraph::measuredCost(const NodeId node) const -> double {
+    return isValid(node) ? mNodes[node].measuredCost : 0.0;
+}
+
+auto TaskGraph::isValid(const NodeId node) const -> bool {
+    return node >= 0 && node < static_cast<NodeId>(mNodes.size());
+}
+
+auto TaskGraph::computeBottomLevels() -> int {
+    std::vector<NodeId> order;
+    std::vector<int>    indegree(mNodes.size());
+    order.reserve(mNodes.size());
+    for (NodeId i = 0; i < static_cast<NodeId>(mNodes.size()); ++i) {
+        indegree[i] = mNodes[i].predecessorCount;
+        if (indegree[i] == 0) {
+            order.push_back(i);
+        }
+    }
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        if (mNodes[order[i]].condition != nullptr) {
+            continue;
+        }
+        for (auto successor : mNodes[order[i]].successors) {
+            if (--indegree[successor] == 0) {
+                order.push_back(successor);
+            }
+        }
+    }
+    if (order.size() != mNodes.size()) {
+        return -1;
+    }
+    mCriticalPathLength = 0.0;
+    for (auto iter = order.rbegin(); iter != order.rend(); ++iter) {
+        auto&  node    = mNodes[*iter];
+        double longest = 0.0;
+        if (node.condition == nullptr) {
+            for (auto successor : node.successors) {
+                longest = std::max(longest, mNodes[successor].bottomLevel);
+            }
+        }
+        node.bottomLevel    = longest + (mUseMeasuredCost && node.measuredCost > 0.0 ? node.measuredCost : node.cost);
+        mCriticalPathLength = std::max(mCriticalPathLength, node.bottomLevel);
+    }
+    return 0;
+}
+
+auto TaskGraph::pushReady(const NodeId node) -> void {
+    auto priority = mSchedule == GraphSchedule::CriticalPath ? mNodes[node].bottomLevel
+                                                              : -static_cast<double>(mReadySequence);
+    ++mReadySequence;
+    mReady.emplace_back(priority, node);
+    std::push_heap(mReady.begin(), mReady.end(), readyLess);
+}
+
+auto TaskGraph::submitSlot() -> void {
+    bool refused = false;
+    if (mPool != nullptr) {
+        TaskDescription desc;
+        desc.arena = mArena;
+        auto slot  = mPool->addTask(SlotRunner{this}, std::move(desc));
+        refused    = slot == nullptr || slot->state() == TaskState::Cancelled;
+    } else {
+        refused = mExecute(SlotRunner{this}) != 0;
+    }
+    if (refused) {
+        LLWFLOWS_LOG_ERROR("Task graph add slot task failed, cancel the run.");
+        skipSlot();
+    }
+}
+
+auto TaskGraph::skipSlot() -> void {
+    // the run can not finish normally, the node with the highest priority is finished here without running it.
+    mRunPromise->requestCancel(false);
+    runReadyNode();
+}
+
+auto TaskGraph::runReadyNode() -> void {
+    NodeId nodeId = -1;
+    {
+        std::lock_guard<detail::SpinLock> lock(mReadyLock);
+        std::pop_heap(mReady.begin(), mReady.end(), readyLess);
+        nodeId = mReady.back().second;
+        mReady.pop_back();
+    }
+    auto& node = mNodes[nodeId];
+    // all strong predecessors are counted by now, rearm the node in case a loop comes back to it.
+    node.pending.store(node.predecessorCount, std::memory_order_relaxed);
+    int  selected = -1;
+    bool joined   = false;
+    if (!mRunPromise->isCancelRequested()) {
+        auto tStart = mUseMeasuredCost ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        if (node.condition != nullptr) {
+            selected = node.condition();
+        } else if (node.subflow != nullptr) {
+            // only the build is measured, the child graph weighs its own nodes.
+            joined = spawnSubflow(nodeId);
+        } else {
+            node.func();
+        }
+        if (mUseMeasuredCost) {
+            auto cost = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - tStart).count();
+            node.measuredCost =
+                node.measuredCost > 0.0 ? node.measuredCost * (1.0 - kCostSmoothing) + cost * kCostSmoothing : cost;
+        }
+    }
+    if (!joined) {
+        finishNode(nodeId, selected);
+    }
+}
+
+auto TaskGraph::spawnSubflow(const NodeId node) -> bool {
+    // the child graph of the last run has ended, the node only runs again after it finished.
+    auto& child = mNodes[node].child;
+    child       = mArena == nullptr ? std::make_shared<TaskGraph>()
+                                    : std::allocate_shared<TaskGraph>(ArenaAllocator<TaskGraph>(mArena));
+    child->mParent          = this;
+    child->mParentNode      = node;
+    child->mSchedule        = mSchedule;
+    child->mUseMeasuredCost = mUseMeasuredCost;
+    mNodes[node].subflow(*child);
+    if (child->mNodes.empty()) {
+        return false;
+    }
+    if (child->start(mPool, mExecute, mArena) == nullptr) {
+        LLWFLOWS_LOG_ERROR("Subflow of task graph node[{}] can not run.", mNodes[node].name.view());
+        return false;
+    }
+    return true;
+}
+
+auto TaskGraph::finishNode(const NodeId node, const int selected) -> void {
+    auto& successors = mNodes[node].successors;
+    int   readyCount = 0;
+    if (mNodes[node].condition != nullptr) {
+        if (selected >= 0 && selected < static_cast<int>(successors.size())) {
+            std::lock_guard<detail::SpinLock> lock(mReadyLock);
+            pushReady(successors[selected]);
+            ++readyCount;
+        }
+    } else {
+        for (auto successor : successors) {
+            if (mNodes[successor].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<detail::SpinLock> lock(mReadyLock);
+                pushReady(successor);
+                ++readyCount;
+            }
+        }
+    }
+    // successors are in flight before this node leaves, so the count only drops to zero at the end of the run.
+    mInFlight.fetch_add(readyCount, std::memory_order_relaxed);
+    for (int i = 0; i < readyCount; ++i) {
+        submitSlot();
+    }
+    if (mInFlight.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // the graph may be destroyed as soon as the run promise is finished, nothing of it is touched after.
+        auto promise    = mRunPromise;
+        auto parent     = mParent;
+        auto parentNode = mParentNode;
+        if (parent != nullptr) {
+            // registered at every run of the subflow, a loop over the node would grow the list of the parent run.
+            parent->mRunPromise->removeDependent(promise.get());
+        }
+        if (promise->isCancelRequested()) {
+            promise->changeState(TaskState::Running, TaskState::Cancelled);
+        } else {
+            promise->done();
+        }
+        if (parent != nullptr) {
+            // a subflow joins its node, the parent graph owns this one and outlives the call.
+            parent->finishNode(parentNode, -1);
+        }
+    }
+}
+
+LLWFLOWS_NS_END
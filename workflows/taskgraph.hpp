@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "actuators.hpp"
+#include "detail/spinlock.hpp"
+#include "taskname.hpp"
+#include "threadpools.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief order in which ready nodes of a TaskGraph are started
+ *
+ * Fifo: in the order they become ready.
+ * CriticalPath: longest remaining path (bottom level) first, so the longest chains start as early as possible.
+ */
+enum class GraphSchedule { Fifo, CriticalPath };
+
+/**
+ * @brief static DAG of tasks run on a ThreadPool, or on any executor
+ *
+ * the whole graph is known before it runs, so the bottom level of every node (its cost plus the longest cost path to
+ * any sink) is computed once per run. every time a node becomes ready one slot task is added to the pool, the slot
+ * runs the ready node with the highest priority at the time a worker picks it up, not the node which made it.
+ *
+ * a condition node returns the index of the successor to run next, in the order its edges were added, any other value
+ * runs none. its edges are weak: the selected node runs at once whatever its other predecessors, and they may go back
+ * to an earlier node, so branches and loops are decided on the workers. the run ends when no node is ready or running,
+ * nodes of branches not taken are skipped.
+ *
+ * a subflow node builds a child graph when it runs, e.g. one node per input it found, which runs on the same pool
+ * with the arena of the parent run. the node finishes when the child graph does, no worker waits for it meanwhile,
+ * and a cancel of the parent run reaches the child run.
+ *
+ * a slot the pool refuses or drops (ThreadPool::stop()) cancels the run, the nodes left are skipped and it still ends.
+ *
+ * @note
+ * the graph must outlive its runs, and it can not be changed or run again while a run is in flight. a node reached
+ * by a weak edge should not have other predecessors, and weak edges are not weighed in the bottom level. the child
+ * graph of a subflow node is kept, with the arena it was allocated from, until the node runs again.
+ */
+class LLWFLOWS_API TaskGraph {
+public:
+    using NodeId  = int;
+    using Subflow = std::function<void(TaskGraph& subflow)>;
+
+    TaskGraph()  = default;
+    ~TaskGraph() = default;
+
+    auto addNode(std::function<void()> func, const TaskName& name = TaskName(), const double cost = 1.0) -> NodeId;
+    ///> @brief add a condition node, func returns the index of the successor to run
+    auto addCondition(std::function<int()> func, const TaskName& name = TaskName(), const double cost = 1.0)
+        -> NodeId;
+    ///> @brief add a subflow node, func adds the nodes and edges of the child graph to subflow
+    auto addSubflow(Subflow func, const TaskName& name = TaskName(), const double cost = 1.0) -> NodeId;
+    ///> @brief to runs after from finished, return -1 if any id is invalid
+    auto addEdge(const NodeId from, const NodeId to) -> int;
+    ///> @brief estimated cost of node, in microseconds if measured cost is used too
+    auto setCost(const NodeId node, const double cost) -> int;
+    auto setSchedule(const GraphSchedule schedule) -> void;
+    /**
+     * @brief weight the bottom level by the measured run time of nodes (microseconds, moving average over runs)
+     * instead of the estimated cost. nodes never measured keep their estimate.
+     */
+    auto useMeasuredCost(const bool enable) -> void;
+    /**
+     * @brief start a run of the graph on pool
+     *
+     * @param arena run the slot tasks and the promises of the run, subflows included, are allocated from, or nullptr
+     *
+     * @return std::shared_ptr<TaskPromise> promise of the whole run, Done when all nodes finished, Cancelled if a
+     * cancel was requested on it. nullptr if the graph has a cycle not closed by a condition node, has no source or a
+     * run is still in flight.
+     */
+    auto run(ThreadPool& pool, std::shared_ptr<TaskArena> arena = nullptr) -> std::shared_ptr<TaskPromise>;
+    /**
+     * @brief start a run of the graph on executor, e.g. a StrandExecutor to run its nodes one at a time
+     *
+     * the slot tasks are given to the executor, so only the promises of the run and the child graphs are allocated
+     * from arena. subflows run on the same executor.
+     *
+     * @note the executor must outlive the run. an inline executor runs the nodes recursively in the calling thread.
+     */
+    template <LLWFLOWS_EXECUTOR E>
+    auto run(E& executor, std::shared_ptr<TaskArena> arena = nullptr) -> std::shared_ptr<TaskPromise> {
+        return start(nullptr, [&executor](std::function<void()> task) { return executor.execute(std::move(task)); },
+                     std::move(arena));
+    }
+
+    auto nodeCount() const -> int;
+    auto name(const NodeId node) const -> TaskName;
+    ///> @brief bottom level computed by the last run
+    auto bottomLevel(const NodeId node) const -> double;
+    ///> @brief longest cost path of the last run
+    auto criticalPathLength() const -> double;
+    ///> @brief moving average of run time in microseconds, 0 if never measured
+    auto measuredCost(const NodeId node) const -> double;
+
+private:
+    friend class ThreadPool;
+
+    TaskGraph(const TaskGraph&)                    = delete;
+    auto operator=(const TaskGraph&) -> TaskGraph& = delete;
+
+    // what a slot task runs, named so a slot dropped by the pool can be recognized
+    struct SlotRunner {
+        TaskGraph* graph;
+        auto       operator()() -> void { graph->runReadyNode(); }
+    };
+
+    struct Node {
+        std::function<void()>      func;
+        std::function<int()>       condition;  ///> set for condition nodes instead of func, all their edges are weak
+        Subflow                    subflow;    ///> set for subflow nodes instead of func
+        std::shared_ptr<TaskGraph> child;      ///> graph built by the last run of the subflow
+        TaskName                   name;
+        std::vector<NodeId>        successors;
+        int                        predecessorCount{0};      ///> strong edges, counted down before the node is ready
+        int                        weakPredecessorCount{0};  ///> edges from condition nodes
+        double                     cost{1.0};
+        double                     measuredCost{0.0};
+        double                     bottomLevel{0.0};
+        std::atomic<int>           pending{0};
+    };
+
+    using Execute = std::function<int(std::function<void()>)>;
+
+    ///> @brief start a run whose slots are added to pool, or given to execute if pool is nullptr
+    auto start(ThreadPool* pool, Execute execute, std::shared_ptr<TaskArena> arena) -> std::shared_ptr<TaskPromise>;
+    auto isValid(const NodeId node) const -> bool;
+    ///> @brief compute the bottom level of all nodes in reverse topological order of strong edges, -1 on a cycle
+    auto computeBottomLevels() -> int;
+    ///> @brief put node in the ready heap, must hold mReadyLock
+    auto pushReady(const NodeId node) -> void;
+    ///> @brief add one slot task to the pool (or executor) for one ready node
+    auto submitSlot() -> void;
+    ///> @brief slot task body, run the ready node with the highest priority
+    auto runReadyNode() -> void;
+    ///> @brief a slot will not run (refused or dropped by the pool), cancel the run and finish a node without it
+    auto skipSlot() -> void;
+    ///> @brief build and start the child graph of node, false if it has nothing to run and the node finishes now
+    auto spawnSubflow(const NodeId node) -> bool;
+    ///> @brief make the successors selected by node ready, selected: branch taken by a condition node
+    auto finishNode(const NodeId node, const int selected) -> void;
+
+private:
+    std::deque<Node> mNodes;
+    GraphSchedule    mSchedule{GraphSchedule::CriticalPath};
+    bool             mUseMeasuredCost{false};
+    double           mCriticalPathLength{0.0};
+    // state of the run in flight
+    ThreadPool*                            mPool{nullptr};
+    Execute                                mExecute;  ///> used when mPool is nullptr
+    std::shared_ptr<TaskArena>             mArena;
+    std::shared_ptr<TaskPromise>           mRunPromise;
+    TaskGraph*                             mParent{nullptr};  ///> graph of the subflow node, nullptr for the top graph
+    NodeId                                 mParentNode{-1};
+    std::atomic<int>                       mInFlight{0};  ///> nodes ready or running
+    detail::SpinLock                       mReadyLock;
+    std::vector<std::pair<double, NodeId>> mReady;  ///> max heap of (priority, node)
+    uint64_t                               mReadySequence{0};
+};
+
+LLWFLOWS_NS_END
@@ -0,0 +1,74 @@
+#include "taskname.hpp"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+LLWFLOWS_NS_BEGIN
+namespace {
+struct NameTable {
+    std::shared_mutex                              mutex;
+    std::unordered_map<std::string_view, uint32_t> ids;    ///> keys view the strings in names
+    std::deque<std::string>                        names;  ///> name of id is names[id - 1], never moved
+};
+
+auto nameTable() -> NameTable& {
+    static NameTable table;
+    return table;
+}
+}  // namespace
+
+// names repeat a lot in one thread, so most lookups end here without touching the shared lock.
+static thread_local std::unordered_map<std::string_view, uint32_t> kNameCache;
+
+TaskName::TaskName(std::string_view name) {
+    if (name.empty()) {
+        return;
+    }
+    if (auto iter = kNameCache.find(name); iter != kNameCache.end()) {
+        mId   = iter->second;
+        mView = iter->first;
+        return;
+    }
+    auto& table = nameTable();
+    {
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        if (auto iter = table.ids.find(name); iter != table.ids.end()) {
+            mId   = iter->second;
+            mView = iter->first;
+        }
+    }
+    if (mId == 0) {
+        std::unique_lock<std::shared_mutex> lock(table.mutex);
+        if (auto iter = table.ids.find(name); iter != table.ids.end()) {
+            mId   = iter->second;
+            mView = iter->first;
+        } else {
+            table.names.emplace_back(name);
+            mId   = static_cast<uint32_t>(table.names.size());
+            mView = table.names.back();
+            table.ids.emplace(mView, mId);
+        }
+    }
+    kNameCache.emplace(mView, mId);
+}
+
+auto TaskName::fromId(const uint32_t id) -> TaskName {
+    TaskName                            name;
+    auto&                               table = nameTable();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    if (id > 0 && id <= table.names.size()) {
+        name.mId   = id;
+        name.mView = table.names[id - 1];
+    }
+    return name;
+}
+
+auto TaskName::internedCount() -> std::size_t {
+    auto&                               table = nameTable();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    return table.names.size();
+}
+
+LLWFLOWS_NS_END
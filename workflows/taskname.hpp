@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "detail/workflowsglobal.hpp"
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief interned task name
+ *
+ * the text is stored once in a global symbol table for the whole process, a TaskName is only its id and a view of
+ * that storage, so copying a name never allocates. equal texts always get the same id.
+ *
+ * @note names are never removed from the table, intern a bounded set of names (e.g. per stage, not per item).
+ */
+class LLWFLOWS_API TaskName {
+public:
+    TaskName() noexcept = default;
+    TaskName(std::string_view name);
+    TaskName(const std::string& name) : TaskName(std::string_view(name)) {}
+    TaskName(const char* name) : TaskName(std::string_view(name)) {}
+
+    ///> @brief stable id of the name, 0 for the empty name
+    inline auto id() const noexcept -> uint32_t { return mId; }
+    inline auto view() const noexcept -> std::string_view { return mView; }
+    inline auto empty() const noexcept -> bool { return mId == 0; }
+    inline auto operator==(const TaskName& other) const noexcept -> bool { return mId == other.mId; }
+    inline auto operator!=(const TaskName& other) const noexcept -> bool { return mId != other.mId; }
+
+    ///> @brief name of id, the empty name if id is unknown
+    static auto fromId(const uint32_t id) -> TaskName;
+    ///> @brief count of names in the symbol table
+    static auto internedCount() -> std::size_t;
+
+private:
+    uint32_t         mId{0};
+    std::string_view mView{};
+};
+
+LLWFLOWS_NS_END
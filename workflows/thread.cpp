@@ -15,15 +15,8 @@ static std::map<std::thread::id, Thread*> kThreads;
 // ------------ Thread ------------
 auto Thread::setName(const char* name) -> void {
     mName = name;
-    if (isRunning()) {
-        auto thread_handle = mThreadMetaData->native_handle();
-#ifdef __linux__
-        pthread_setname_np(thread_handle, name);
-#else
-        std::unique_ptr<wchar_t[]> w_name = std::make_unique<wchar_t[]>(strlen(name) + 1);
-        mbstowcs(w_name.get(), name, strlen(name) + 1);
-        SetThreadDescription(thread_handle, w_name.get());
-#endif
+    if (isRunning() && mThreadMetaData) {
+        setNameImpl(mThreadMetaData->native_handle(), name);
     }
 }
 
@@ -51,7 +44,8 @@ auto Thread::start() -> void {
 auto Thread::setPriority(const int policy, const int priority) -> void {
     mPriority = priority;
     mPolicy   = policy;
-    setPriorityImpl(policy, priority);
+    setPriorityImpl(mThreadMetaData ? mThreadMetaData->native_handle() : std::thread::native_handle_type{}, policy,
+                    priority);
 }
 
 auto Thread::priority() const -> std::pair<int, int> {
@@ -132,13 +126,29 @@ auto Thread::isJoinable() const -> bool {
 
 auto Thread::runImpl() -> void {
     mIsRunning = true;
-    setName(mName.c_str());
-    setPriorityImpl(mPolicy, mPriority);
+    // mThreadMetaData may not be assigned yet by start(), so use the handle of the calling thread.
+#ifdef __linux__
+    setNameImpl(pthread_self(), mName.c_str());
+    setPriorityImpl(pthread_self(), mPolicy, mPriority);
+#else
+    setNameImpl(GetCurrentThread(), mName.c_str());
+    setPriorityImpl(GetCurrentThread(), mPolicy, mPriority);
+#endif
     run();
     mIsRunning = false;
 }
 
-auto Thread::setPriorityImpl(const int policy, const int priority) -> void {
+auto Thread::setNameImpl(std::thread::native_handle_type handle, const char* name) -> void {
+#ifdef __linux__
+    pthread_setname_np(handle, name);
+#else
+    std::unique_ptr<wchar_t[]> w_name = std::make_unique<wchar_t[]>(strlen(name) + 1);
+    mbstowcs(w_name.get(), name, strlen(name) + 1);
+    SetThreadDescription(handle, w_name.get());
+#endif
+}
+
+auto Thread::setPriorityImpl(std::thread::native_handle_type handle, const int policy, const int priority) -> void {
 #ifdef __linux__
     pthread_attr_t attr;
     if (auto ret = pthread_attr_init(&attr); ret != 0) {
@@ -155,9 +165,8 @@ auto Thread::setPriorityImpl(const int policy, const int priority) -> void {
     if (auto ret = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED); ret != 0) {
         LLWFLOWS_LOG_ERROR("Failed to set thread inheritance, error: {}", strerror(ret));
     }
-    if (mThreadMetaData) {
-        pthread_t thread_handle = mThreadMetaData->native_handle();
-        if (auto ret = pthread_setschedparam(thread_handle, policy, &param); ret != 0) {
+    if (handle != std::thread::native_handle_type{}) {
+        if (auto ret = pthread_setschedparam(handle, policy, &param); ret != 0) {
             LLWFLOWS_LOG_ERROR("Failed to set thread({}) priority, error: {}", name(), strerror(ret));
         }
     }
@@ -46,7 +46,8 @@ private:
     Thread(const Thread&)                    = delete;
     auto operator=(const Thread&) -> Thread& = delete;
     auto runImpl() -> void;
-    auto setPriorityImpl(const int policy, const int priority) -> void;
+    auto setNameImpl(std::thread::native_handle_type handle, const char* name) -> void;
+    auto setPriorityImpl(std::thread::native_handle_type handle, const int policy, const int priority) -> void;
 
 private:
     std::string                  mName{};
@@ -1,8 +1,16 @@
 #include "threadpools.hpp"
 
+#include <algorithm>
+
+#include "detail/futex.hpp"
 #include "detail/log.hpp"
+#include "executionplan.hpp"
+#include "strand.hpp"
+#include "taskgraph.hpp"
 
 LLWFLOWS_NS_BEGIN
+// plan being captured by the calling thread, tasks it adds to the pool of the plan are recorded instead of run.
+static thread_local std::shared_ptr<ExecutionPlan> kCapturePlan;
 
 ThreadPool::ThreadPool(size_t numThreads) : mWorkers(numThreads) {
     for (size_t i = 0; i < numThreads; ++i) {
@@ -11,191 +19,603 @@ ThreadPool::ThreadPool(size_t numThreads) : mWorkers(numThreads) {
 }
 
 ThreadPool::~ThreadPool() {
-    for (auto& worker : mWorkers) {
-        if (worker.isRunning()) {
-            worker.exit();
-            worker.waitForExit();
-        }
-    }
+    stopTimer();
+    stopReactor();
+    shutdownWorkers(false);
 }
 
 std::shared_ptr<TaskPromise> ThreadPool::addTask(std::function<void()> task, const TaskDescription& desc) {
+    return addTask(std::move(task), TaskDescription(desc));
+}
+
+std::shared_ptr<TaskPromise> ThreadPool::addTask(std::function<void()> task, TaskDescription&& desc) {
     if (mWorkers.empty()) {
         LLWFLOWS_LOG_WARN("No worker available");
         return std::shared_ptr<TaskPromise>();
     }
-    auto taskPromise = distributeTask(task, desc);
+    auto taskPromise = kCapturePlan != nullptr && &kCapturePlan->mPool == this
+                           ? kCapturePlan->record(std::move(task), std::move(desc))
+                           : distributeTask(std::move(task), std::move(desc));
     if (taskPromise != nullptr) {
         taskPromise->taskId(++mTaskCount);
     }
     return std::move(taskPromise);
 }
 
+auto ThreadPool::beginCapture() -> int {
+    if (kCapturePlan != nullptr) {
+        LLWFLOWS_LOG_ERROR("Capture of an execution plan is already in progress on this thread.");
+        return -1;
+    }
+    kCapturePlan.reset(new ExecutionPlan(*this));
+    return 0;
+}
+
+auto ThreadPool::endCapture() -> std::shared_ptr<ExecutionPlan> {
+    if (kCapturePlan == nullptr || &kCapturePlan->mPool != this) {
+        LLWFLOWS_LOG_ERROR("No capture of an execution plan in progress on this thread for this pool.");
+        return nullptr;
+    }
+    auto plan = std::move(kCapturePlan);
+    plan->freeze();
+    return plan;
+}
+
+auto ThreadPool::post(std::function<void()> task) -> int {
+    if (mWorkers.empty()) {
+        LLWFLOWS_LOG_WARN("No worker available");
+        return -1;
+    }
+    mOutstandingTasks.fetch_add(1);
+    auto packed  = new PackedTask{TaskDescription(), std::move(task)};
+    auto promise = placeTask(packed, packTask(packed));
+    return promise == nullptr || promise->state() == TaskState::Cancelled ? -1 : 0;
+}
+
+auto ThreadPool::addTaskAt(Clock::time_point timePoint, std::function<void()> task, const TaskDescription& desc)
+    -> std::shared_ptr<TaskPromise> {
+    if (mWorkers.empty()) {
+        LLWFLOWS_LOG_WARN("No worker available");
+        return std::shared_ptr<TaskPromise>();
+    }
+    DelayedTask delayedTask;
+    delayedTask.task    = std::move(task);
+    delayedTask.promise = desc.promise == nullptr ? std::make_shared<TaskPromise>() : desc.promise;
+    if (!desc.name.empty() || desc.specifyWorkerId != -1 || !desc.dependencies.empty() ||
+        desc.priority != TaskPriority::Normal || desc.affinityKey != 0 || desc.arena != nullptr ||
+        desc.latch != nullptr || desc.rateLimiter != nullptr) {
+        delayedTask.desc.reset(new TaskDescription(desc));
+    }
+    delayedTask.promise->taskId(++mTaskCount);
+    auto promise = delayedTask.promise;
+    scheduleDelayedTask(timePoint, std::move(delayedTask));
+    return promise;
+}
+
+auto ThreadPool::addTaskAfter(std::chrono::nanoseconds delay, std::function<void()> task, const TaskDescription& desc)
+    -> std::shared_ptr<TaskPromise> {
+    return addTaskAt(Clock::now() + std::chrono::duration_cast<Clock::duration>(delay), std::move(task), desc);
+}
+
+auto ThreadPool::addPeriodicTask(std::chrono::nanoseconds period, std::function<void()> task,
+                                 const TaskDescription& desc) -> std::shared_ptr<TaskPromise> {
+    if (period.count() <= 0) {
+        LLWFLOWS_LOG_ERROR("Invalid period: {}ns", period.count());
+        return std::shared_ptr<TaskPromise>();
+    }
+    if (mWorkers.empty()) {
+        LLWFLOWS_LOG_WARN("No worker available");
+        return std::shared_ptr<TaskPromise>();
+    }
+    DelayedTask delayedTask;
+    delayedTask.task    = std::move(task);
+    delayedTask.promise = desc.promise == nullptr ? std::make_shared<TaskPromise>() : desc.promise;
+    delayedTask.desc.reset(new TaskDescription(desc));
+    delayedTask.desc->promise = nullptr;
+    delayedTask.period        = period;
+    delayedTask.promise->taskId(++mTaskCount);
+    auto promise = delayedTask.promise;
+    scheduleDelayedTask(Clock::now() + std::chrono::duration_cast<Clock::duration>(period), std::move(delayedTask));
+    return promise;
+}
+
 int  ThreadPool::cancel(std::shared_ptr<TaskPromise> task) { return task->cancel(); }
 
+auto ThreadPool::cancelSubgraph(std::shared_ptr<TaskPromise> task) -> int { return task->requestCancel(true); }
+
 void ThreadPool::wait(std::shared_ptr<TaskPromise> task) {
-    while (task->state() == (TaskState)TaskStateCustom::TaskDependsUnfinish || task->state() == TaskState::Queuing ||
-           task->state() == TaskState::Running) {
-#if LLWFLOWS_CPP_PLUS < 20
-        std::unique_lock<std::mutex> lock(mMutex);
-        while (task->state() == TaskState::Queuing || task->state() == TaskState::Running) {
-            mCondition.wait(lock, [task]() {
-                return !(task->state() == TaskState::Queuing || task->state() == TaskState::Running);
-            });
-        }
-#else
-        task->wait();
-#endif
+    // a task retried for its dependencies is still pending, the promise waits through it. the awaited task may sit in
+    // the queue of this very worker, so a worker keeps running tasks instead of blocking on it.
+    task->wait();
+}
+
+auto ThreadPool::waitAll(const std::vector<std::shared_ptr<TaskPromise>>& tasks) -> void {
+    for (auto& task : tasks) {
+        if (task != nullptr) {
+            task->wait();
+        }
     }
 }
 
 void ThreadPool::start(const bool enableWorkStealing) {
+    mStopping.store(false, std::memory_order_release);
+    {
+        // tasks waiting for a token may use the timer again after a stop.
+        std::lock_guard<std::mutex> lock(mTimerMutex);
+        mTimerExit = false;
+    }
+    if (enableWorkStealing && !ThreadWorker::kStealable) {
+        LLWFLOWS_LOG_WARN("Only local queues can be stolen, the task queue policy of worker is single consumer.");
+    }
+    mWorkStealing = enableWorkStealing;
     for (auto& worker : mWorkers) {
         if (enableWorkStealing) {
             worker.registerCallbackInIdleLoop(
                 std::bind(&ThreadPool::onWorkerIdle, this, std::placeholders::_1, std::placeholders::_2));
+            worker.registerStealCallback(
+                std::bind(&ThreadPool::stealTask, this, std::placeholders::_1, std::placeholders::_2));
         }
+        worker.registerUnfinishedCallback(std::bind(&ThreadPool::onTaskUnfinished, this, std::placeholders::_2));
         worker.start();
     }
 }
 
-void ThreadPool::stop() {
-    for (auto& worker : mWorkers) {
-        worker.exit();
+auto ThreadPool::setProfiler(std::shared_ptr<Profiler> profiler) -> void {
+    if (profiler != nullptr) {
+        profiler->attach(static_cast<int>(mWorkers.size()));
     }
+    mProfiler = std::move(profiler);
+}
+
+auto ThreadPool::profiler() const -> const std::shared_ptr<Profiler>& { return mProfiler; }
+
+auto ThreadPool::setPriorityAging(const std::chrono::nanoseconds interval) -> void {
     for (auto& worker : mWorkers) {
-        worker.waitForExit();
+        worker.setAgingInterval(interval);
     }
 }
 
+auto ThreadPool::priorityAging() const -> std::chrono::nanoseconds {
+    return mWorkers.empty() ? ThreadWorker::kDefaultAgingInterval : mWorkers.front().agingInterval();
+}
+
+auto ThreadPool::waitIdle() -> void {
+    mIdleWaiters.fetch_add(1);
+    while (true) {
+        auto epoch = mIdleEpoch.load(std::memory_order_acquire);
+        if (mOutstandingTasks.load() == 0) {
+            break;
+        }
+        detail::futexWait(mIdleEpoch, epoch);
+    }
+    mIdleWaiters.fetch_sub(1);
+}
+
+auto ThreadPool::outstandingTaskCount() const -> int64_t { return mOutstandingTasks.load(std::memory_order_acquire); }
+
+void ThreadPool::stop() {
+    stopTimer();
+    stopReactor();
+    shutdownWorkers(false);
+}
+
 void ThreadPool::stopAndwaitAll() {
-    // FIXME:
-    // 任务在重试过程中有可能推到了其他线程，导致某些线程关闭，然后如果推到未执行的线程中，就会导致后续任务不再执行并退出。
+    // tasks may be retried on any worker while their dependencies are pending, so no worker can leave before the whole
+    // pool is idle. the timer runs meanwhile, the tasks waiting there for a token are outstanding too.
+    waitIdle();
+    stopTimer();
+    stopReactor();
+    // a periodic task may have fired before the timer stopped.
+    waitIdle();
+    shutdownWorkers(true);
+}
+
+#ifdef __linux__
+auto ThreadPool::reactor() -> Reactor& {
+    std::lock_guard<std::mutex> lock(mReactorMutex);
+    if (mReactor == nullptr) {
+        mReactor.reset(new Reactor(*this));
+    }
+    return *mReactor;
+}
+#endif
+
+auto ThreadPool::stopReactor() -> void {
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(mReactorMutex);
+    if (mReactor != nullptr) {
+        mReactor->stop();
+    }
+#endif
+}
+
+auto ThreadPool::shutdownWorkers(const bool afterTaskInQueue) -> void {
+    mStopping.store(true, std::memory_order_release);
+    {
+        // the tasks parked on a latch which is not done are placed, and cancelled as the pool is stopping.
+        std::vector<std::weak_ptr<TaskLatch>> latches;
+        {
+            std::lock_guard<std::mutex> lock(mParkedMutex);
+            latches.swap(mParkedLatches);
+        }
+        for (auto& latch : latches) {
+            if (auto ptr = latch.lock(); ptr != nullptr) {
+                ptr->releaseParked();
+            }
+        }
+    }
+    for (auto& worker : mWorkers) {
+        if (worker.isRunning()) {
+            worker.exit(afterTaskInQueue);
+        }
+    }
     for (auto& worker : mWorkers) {
-        worker.exit(true);
         worker.waitForExit();
     }
+    // a retry may land in a queue after its worker drained it.
+    for (auto& worker : mWorkers) {
+        Task task;
+        while (worker.pop(task) || worker.stealLocal(task)) {
+            task.taskPromise->cancel();
+            onTaskUnfinished(task);
+        }
+    }
 }
 
-auto ThreadPool::distributeTask(std::function<void()> task, const TaskDescription& desc)
-    -> std::shared_ptr<TaskPromise> {
+auto ThreadPool::taskFinished() -> void {
+    if (mOutstandingTasks.fetch_sub(1) == 1) {
+        mIdleEpoch.fetch_add(1, std::memory_order_release);
+        if (mIdleWaiters.load() > 0) {
+            detail::futexWakeAll(mIdleEpoch);
+        }
+    }
+}
+
+auto ThreadPool::distributeTask(std::function<void()> task, TaskDescription&& desc) -> std::shared_ptr<TaskPromise> {
+    if (desc.specifyWorkerId != -1 && (desc.specifyWorkerId >= workerCount() || desc.specifyWorkerId < 0)) {
+        LLWFLOWS_LOG_ERROR("Invalid worker id: {}", desc.specifyWorkerId);
+        return nullptr;
+    }
+    // a task is outstanding from its packing until it is released without retry.
+    mOutstandingTasks.fetch_add(1);
+    PackedTask* packed = nullptr;
+    if (desc.arena != nullptr) {
+        // the packed task and its control block come from the arena of the run, they are freed with it in one shot.
+        auto memory = desc.arena->allocate(sizeof(PackedTask), alignof(PackedTask));
+        packed      = new (memory) PackedTask{std::move(desc), std::move(task)};
+    } else {
+        packed = new PackedTask{std::move(desc), std::move(task)};
+    }
+    return placeTask(packed, packTask(packed));
+}
+
+auto ThreadPool::placeTask(PackedTask* packed, std::function<void()> run) -> std::shared_ptr<TaskPromise> {
+    auto& desc = packed->desc;
     if (desc.specifyWorkerId != -1) {
-        if (desc.specifyWorkerId >= mWorkers.size() || desc.specifyWorkerId < 0) {
-            LLWFLOWS_LOG_ERROR("Invalid worker id: {}", desc.specifyWorkerId);
-            return nullptr;
-        }
-        auto [taskWithRetry, descptr] = packTask(std::move(task), desc);
-        return addTaskImp(std::move(taskWithRetry), *descptr, desc.specifyWorkerId);
-    }
-    auto [taskWithRetry, descptr] = packTask(std::move(task), desc);
-    int workerId                  = -1;
-    switch (desc.priority) {
-        case TaskPriority::Low:
-            workerId = pickWorkerIdByWorkload(-1);
-            break;
-        case TaskPriority::Normal:
-            workerId = pickWorkerIdByRandom();
-            break;
-        case TaskPriority::High:
-            workerId = pickWorkerIdByIdleness(0);
-            if (workerId == -1) {
+        return addTaskImp(std::move(run), desc, desc.specifyWorkerId);
+    }
+    int affinityWorkerId = desc.affinityKey != 0 ? pickWorkerIdByAffinity(desc.affinityKey) : -1;
+    // a task spawned by a task of this pool stays on the same worker while its input is hot in cache, unless it prefers
+    // another worker. retries go through the placement below, or they would be popped again before the dependency
+    // below them in the local queue. low priority tasks neither, the local queue runs before all lanes.
+    if (mWorkStealing && desc.spawnLocal && desc.retryCount == 0 && desc.priority != TaskPriority::Low) {
+        if (auto workerId = currentWorkerId();
+            workerId != -1 && (desc.affinityKey == 0 || workerId == affinityWorkerId)) {
+            return addTaskImp(std::move(run), desc, workerId, true);
+        }
+    }
+    int workerId = affinityWorkerId;
+    if (desc.affinityKey != 0 && workerId == -1) {
+        // the preferred worker is loaded, spill to the least loaded one instead of queuing behind it.
+        workerId = pickWorkerIdByWorkload(0);
+    }
+    if (desc.affinityKey == 0) {
+        switch (desc.priority) {
+            case TaskPriority::Low:
+                // the low lane of every worker is behind its other lanes, so it goes where the least work is queued.
                 workerId = pickWorkerIdByWorkload(0);
-            }
+                break;
+            case TaskPriority::Normal:
+                workerId = pickWorkerIdByRandom();
+                break;
+            case TaskPriority::High:
+                workerId = pickWorkerIdByIdleness(0);
+                if (workerId == -1) {
+                    workerId = pickWorkerIdByWorkload(0);
+                }
+        }
     }
     if (workerId == -1) {
         workerId = pickWorkerIdByRandom();
     }
-    if (descptr->retryCount > 10) {
-        for (auto& dep : descptr->dependencies) {
-            if (dep->workerIds().size() > 0 && dep->state() != TaskState::Done) {
-                workerId = dep->workerIds().back();
+    if (workerId == -1) {
+        workerId = pickWorkerIdByRoundRobin();
+    }
+    if (desc.retryCount > 10) {
+        for (auto& dep : desc.dependencies) {
+            if (auto depWorkerId = dep->lastWorkerId(); depWorkerId != -1 && dep->state() != TaskState::Done) {
+                workerId = depWorkerId;
                 break;
             }
         }
     }
-    LLWFLOWS_DEBUG("add task[{}] to worker {} with priority {}, workerqueuesize {}, idle count {}", descptr->name,
-                   workerId, (int)desc.priority, mWorkers[workerId].taskQueue().size(), mWorkers[workerId].idleLoopCount());
-    return addTaskImp(std::move(taskWithRetry), *descptr, workerId);
+    LLWFLOWS_DEBUG("add task[{}] to worker {} with priority {}, workerqueuesize {}, idle count {}", desc.name.view(),
+                   workerId, (int)desc.priority, mWorkers[workerId].queuedTaskCount(),
+                   mWorkers[workerId].idleLoopCount());
+    return addTaskImp(std::move(run), desc, workerId);
 }
 
 auto ThreadPool::onWorkerIdle(const int workerId, const int IdleCount) -> void {
     if (IdleCount >= mWorkers[workerId].maxIdleLoopCount() / 1000) {
-        auto idx = pickWorkerIdByQueueSize(-1);
-        if (idx == -1) {
-            return;
-        }
         Task task;
-        if (mWorkers[idx].taskQueue().size() <= 1 || !mWorkers[idx].taskQueue().pop(task)) {
+        if (!stealTask(workerId, task)) {
             return;
         }
+        // the queues of an idle worker are empty, so it never fails in practice.
+        if (mWorkers[workerId].postLocal(std::move(task)) != 0) {
+            LLWFLOWS_LOG_ERROR("Worker {} post stolen task[{}] failed.", workerId, task.taskPromise->taskId());
+            task.taskPromise->cancel();
+        }
+    }
+}
 
-        while (!mWorkers[workerId].taskQueue().push(task)) {
-            if (mWorkers[idx].taskQueue().push(task)) {
-                return;
+auto ThreadPool::stealTask(const int workerId, Task& task) -> bool {
+    auto tStart = mProfiler != nullptr ? Profiler::Clock::now() : Profiler::Clock::time_point();
+    // the oldest task spawned locally by a busy worker is usually the biggest piece of work left.
+    for (int i = 1; i < workerCount(); ++i) {
+        auto victim = (workerId + i) % mWorkers.size();
+        if (mWorkers[victim].stealLocal(task)) {
+            LLWFLOWS_DEBUG("steal local task[{}] from worker {} to worker {}", task.taskPromise->taskId(), victim,
+                           workerId);
+            if (mProfiler != nullptr) {
+                mProfiler->recordSteal(workerId, tStart);
             }
+            return true;
         }
-        LLWFLOWS_LOG_INFO("steal task[{}] from worker {} to worker {}", task.taskPromise->taskId(), idx, workerId);
     }
+    if constexpr (!ThreadWorker::kStealable) {
+        return false;
+    }
+    auto idx = pickWorkerIdByQueueSize(-1);
+    if (idx == -1 || idx == workerId || mWorkers[idx].queuedTaskCount() <= 1 || !mWorkers[idx].pop(task)) {
+        return false;
+    }
+    LLWFLOWS_LOG_INFO("steal task[{}] from worker {} to worker {}", task.taskPromise->taskId(), idx, workerId);
+    if (mProfiler != nullptr) {
+        mProfiler->recordSteal(workerId, tStart);
+    }
+    return true;
 }
 
-auto ThreadPool::packTask(std::function<void()> task, const TaskDescription& desc)
-    -> std::pair<std::function<void()>, TaskDescription*> {
-    std::shared_ptr<TaskDescription> descptr =
-        std::shared_ptr<TaskDescription>(new TaskDescription{std::move(desc)}, [this, task](TaskDescription* p) {
-            if (p->promise == nullptr) {
-                delete p;
-                return;
-            }
-#if LLWFLOWS_CPP_PLUS < 20
-            if (p->promise->state() != TaskState::Running && p->promise->state() != TaskState::Queuing) {
-                mCondition.notify_all();
-            }
-#endif
-            if (p->promise->state() == (TaskState)TaskStateCustom::TaskDependsUnfinish) {
-                p->retryCount++;
-                distributeTask(task, *p);
-            }
-            if (p->promise->state() == TaskState::Done) {
-                LLWFLOWS_DEBUG("task[{}/{}] fished in worker {}, retry {}, priority {}.", p->name, p->promise->taskId(),
-                               p->promise->workerId(), p->retryCount, (int)p->priority);
+auto ThreadPool::packTask(PackedTask* packed) -> std::function<void()> {
+    // only what ends the task is done here, a retry keeps the closure alive by queuing it again.
+    auto deleter = [this](PackedTask* p) {
+        if (p->desc.promise == nullptr) {
+            finishPackedTask(p);
+            return;
+        }
+        // the closure was dropped while waiting for a retry (e.g. the pool is stopping), it will not run anymore.
+        p->desc.promise->changeState((TaskState)TaskStateCustom::TaskDependsUnfinish, TaskState::Cancelled);
+        p->desc.promise->changeState((TaskState)TaskStateCustom::TaskRateLimited, TaskState::Cancelled);
+        if (p->desc.promise->state() == TaskState::Done) {
+            LLWFLOWS_DEBUG("task[{}/{}] fished in worker {}, retry {}, priority {}.", p->desc.name.view(),
+                           p->desc.promise->taskId(), p->desc.promise->workerId(), p->desc.retryCount,
+                           (int)p->desc.priority);
+        }
+        finishPackedTask(p);
+    };
+    std::shared_ptr<PackedTask> ptr;
+    if (packed->desc.arena != nullptr) {
+        ptr = std::shared_ptr<PackedTask>(packed, std::move(deleter), ArenaAllocator<PackedTask>(packed->desc.arena));
+    } else {
+        ptr = std::shared_ptr<PackedTask>(packed, std::move(deleter));
+    }
+    return PackedTaskRunner{this, std::move(ptr)};
+}
+
+auto ThreadPool::runPackedTask(PackedTask* packed) -> void {
+    auto& desc = packed->desc;
+    // done dependencies stay done, a retry does not scan them again.
+    for (auto& i = packed->doneDependencies; i < desc.dependencies.size(); ++i) {
+        if (desc.dependencies[i]->state() != TaskState::Done) {
+            if (mProfiler != nullptr) {
+                mProfiler->recordRetry(currentWorkerId(), desc.promise->taskId());
             }
-            delete p;
-        });
-    return std::make_pair(
-        [task, desc = descptr]() {
-            for (auto& deps : desc->dependencies) {
-                if (deps->state() != TaskState::Done) {
-                    desc->promise->changeState(TaskState::Running, (TaskState)TaskStateCustom::TaskDependsUnfinish);
-                    return;
+            desc.promise->changeState(TaskState::Running, (TaskState)TaskStateCustom::TaskDependsUnfinish);
+            return;
+        }
+    }
+    // the token is taken when the task could start, so waiting dependencies do not hold tokens.
+    if (desc.rateLimiter != nullptr) {
+        if (auto wait = desc.rateLimiter->tryAcquire(); wait.count() > 0) {
+            packed->tokenWait = wait;
+            desc.promise->changeState(TaskState::Running, (TaskState)TaskStateCustom::TaskRateLimited);
+            return;
+        }
+    }
+    if (mProfiler == nullptr) {
+        packed->func();
+        return;
+    }
+    Profiler::TaskRecord record;
+    record.start = Profiler::Clock::now();
+    packed->func();
+    record.end        = Profiler::Clock::now();
+    record.taskId     = desc.promise->taskId();
+    record.name       = desc.name;
+    record.retryCount = desc.retryCount;
+    for (auto& deps : desc.dependencies) {
+        record.dependencies.push_back(deps->taskId());
+    }
+    mProfiler->recordTask(currentWorkerId(), std::move(record));
+}
+
+auto ThreadPool::onTaskUnfinished(Task& task) -> bool {
+    if (auto node = task.func.target<ExecutionPlan::NodeRunner>(); node != nullptr) {
+        // a node of a plan is not packed, its successors and its replay are released by the plan.
+        if (task.taskPromise->state() != TaskState::Cancelled) {
+            return false;
+        }
+        node->plan->skipNode(node->node);
+        return true;
+    }
+    auto runner = task.func.target<PackedTaskRunner>();
+    if (runner == nullptr || runner->pool != this) {
+        return false;
+    }
+    auto packed = runner->packed.get();
+    auto state  = task.taskPromise->state();
+    if (state == TaskState::Cancelled) {
+        // the owner of a dropped slot of a graph run or drain of a strand still counts on it to run.
+        if (auto slot = packed->func.target<TaskGraph::SlotRunner>(); slot != nullptr) {
+            slot->graph->skipSlot();
+        } else if (auto drain = packed->func.target<Strand::DrainRunner>(); drain != nullptr) {
+            drain->core->dropped();
+        }
+        return false;
+    }
+    if (state == (TaskState)TaskStateCustom::TaskDependsUnfinish) {
+        // the same closure is placed again, nothing of the task is allocated for the retry.
+        packed->desc.retryCount++;
+        auto& dependencies = packed->desc.dependencies;
+        // a latch never runs on a worker to follow, the task waits on it and is placed by its last count down.
+        if (packed->doneDependencies < dependencies.size() &&
+            dynamic_cast<TaskLatch*>(dependencies[packed->doneDependencies].get()) != nullptr) {
+            auto latch  = std::static_pointer_cast<TaskLatch>(dependencies[packed->doneDependencies]);
+            auto parked = latch->onDone(
+                [this, packed, run = std::move(task.func)]() mutable { placeTask(packed, std::move(run)); });
+            if (parked == 0) {
+                std::lock_guard<std::mutex> lock(mParkedMutex);
+                // the latches gone are dropped before the list doubles, so it stays as long as the live ones.
+                if (mParkedLatches.size() == mParkedLatches.capacity()) {
+                    mParkedLatches.erase(std::remove_if(mParkedLatches.begin(), mParkedLatches.end(),
+                                                        [](const auto& latch) { return latch.expired(); }),
+                                         mParkedLatches.end());
                 }
+                mParkedLatches.push_back(latch);
             }
-            task();
-        },
-        descptr.get());
+            return true;
+        }
+        placeTask(packed, std::move(task.func));
+        return true;
+    }
+    if (state == (TaskState)TaskStateCustom::TaskRateLimited) {
+        // if the pool is stopping the token will not come, the closure is dropped and cancels the task.
+        deferTask(packed, task.func);
+        return true;
+    }
+    return false;
 }
 
 std::shared_ptr<TaskPromise> ThreadPool::addTaskImp(std::function<void()> task, TaskDescription& desc,
-                                                    const int workerId) {
+                                                    const int workerId, const bool local) {
     if (desc.promise == nullptr) {
-        desc.promise = std::make_shared<TaskPromise>();
+        desc.promise = desc.arena == nullptr
+                           ? std::make_shared<TaskPromise>()
+                           : std::allocate_shared<TaskPromise>(ArenaAllocator<TaskPromise>(desc.arena));
     }
     desc.promise->resetState();
+    if (desc.promise->isCancelRequested()) {
+        desc.promise->cancel();
+        return desc.promise;
+    }
     for (auto& dep : desc.dependencies) {
-        if (dep->state() == TaskState::Cancelled) {
-            desc.promise->cancel();
+        // register once, so cancelling a dependency reach this task without waiting for its retry.
+        if (dep->state() == TaskState::Cancelled || dep->isCancelRequested() ||
+            (desc.retryCount == 0 && dep->addDependent(desc.promise) != 0)) {
+            desc.promise->requestCancel();
             return desc.promise;
         }
     }
-    if (workerId >= 0 && workerId < mWorkers.size()) {
-        if (mWorkers[workerId].post(std::move(task), desc.promise) == 0) {
-            return desc.promise;
-        }
-    } else {
+    if (mStopping.load(std::memory_order_acquire)) {
+        LLWFLOWS_LOG_WARN("Threadpool is stopping, task[{}] is cancelled.", desc.promise->taskId());
+        desc.promise->cancel();
+        return desc.promise;
+    }
+    if (workerId < 0 || workerId >= workerCount()) {
         LLWFLOWS_LOG_ERROR("Threadpool post invalid worker id: {}", workerId);
+        unregisterDependent(desc);
+        return std::shared_ptr<TaskPromise>();
+    }
+    Task packedTask{std::move(task), desc.promise};
+    if (local && mWorkers[workerId].postLocal(std::move(packedTask)) == 0) {
+        notifyIdleWorker(workerId);
+        return desc.promise;
+    }
+    const auto priority = static_cast<int>(desc.priority);
+    if (mWorkers[workerId].post(std::move(packedTask), priority) == 0) {
+        return desc.promise;
+    }
+    // the queue of picked worker is full, a task which is not pinned should not be lost for it.
+    if (desc.specifyWorkerId == -1) {
+        for (int i = 1; i < workerCount(); ++i) {
+            if (mWorkers[(workerId + i) % mWorkers.size()].post(std::move(packedTask), priority) == 0) {
+                return desc.promise;
+            }
+        }
     }
+    unregisterDependent(desc);
     return std::shared_ptr<TaskPromise>();
 }
 
+auto ThreadPool::unregisterDependent(const TaskDescription& desc) -> void {
+    for (auto& dep : desc.dependencies) {
+        dep->removeDependent(desc.promise.get());
+    }
+}
+
+auto ThreadPool::currentWorkerId() const -> int {
+    auto worker = ThreadWorker::currentWorker();
+    if (worker == nullptr || mWorkers.empty() || worker < &mWorkers.front() || worker > &mWorkers.back()) {
+        return -1;
+    }
+    return worker->workerId();
+}
+
+auto ThreadPool::notifyIdleWorker(const int workerId) -> void {
+    for (int i = 1; i < workerCount(); ++i) {
+        auto& worker = mWorkers[(workerId + i) % mWorkers.size()];
+        if (worker.isSleeping()) {
+            worker.notifyIdle();
+            return;
+        }
+    }
+}
+
+auto ThreadPool::releasePackedTask(PackedTask* packed) -> void {
+    if (packed->desc.arena == nullptr) {
+        delete packed;
+        return;
+    }
+    // the memory goes back with the arena, which the control block of the packed task still holds.
+    packed->~PackedTask();
+}
+
+auto ThreadPool::finishPackedTask(PackedTask* packed) -> void {
+    if (packed->desc.promise != nullptr) {
+        // a finished task can not be cancelled anymore, a long-lived dependency would keep it (and its arena) forever.
+        unregisterDependent(packed->desc);
+    }
+    if (packed->desc.latch != nullptr) {
+        packed->desc.latch->countDown();
+    }
+    releasePackedTask(packed);
+    taskFinished();
+}
+
+auto ThreadPool::deferTask(PackedTask* packed, std::function<void()>& run) -> bool {
+    if (mStopping.load(std::memory_order_acquire)) {
+        return false;
+    }
+    DelayedTask delayedTask;
+    delayedTask.task    = std::move(run);
+    delayedTask.promise = packed->desc.promise;
+    delayedTask.packed  = packed;
+    // a stopped timer is not started again for it, unlike for a new delayed task.
+    return scheduleDelayedTask(Clock::now() + std::chrono::duration_cast<Clock::duration>(packed->tokenWait),
+                               std::move(delayedTask), false);
+}
+
 auto ThreadPool::pickWorkerIdByRoundRobin() -> int { return mCurrentWorkerId++ % mWorkers.size(); }
 
 auto ThreadPool::pickWorkerIdByWorkload(const int idx) -> int {
@@ -203,10 +623,10 @@ auto ThreadPool::pickWorkerIdByWorkload(const int idx) -> int {
         return -1;
     }
     std::vector<std::pair<int, std::pair<int, int>>> workerQueueSize;
-    for (int i = 0; i < mWorkers.size(); i++) {
-        if (mWorkers[i].taskQueue().size() < mWorkers[i].taskQueue().capacity()) {
+    for (int i = 0; i < workerCount(); i++) {
+        if (mWorkers[i].queuedTaskCount() < mWorkers[i].taskQueue().capacity()) {
             workerQueueSize.push_back(
-                std::make_pair(i, std::make_pair(mWorkers[i].taskQueue().size(), mWorkers[i].idleLoopCount())));
+                std::make_pair(i, std::make_pair(mWorkers[i].queuedTaskCount(), mWorkers[i].idleLoopCount())));
         }
     }
     std::sort(workerQueueSize.begin(), workerQueueSize.end(), [](const auto& a, const auto& b) {
@@ -230,8 +650,9 @@ auto ThreadPool::pickWorkerIdByIdleness(const int idx) -> int {
         return -1;
     }
     std::vector<std::pair<int, int>> workerIdleLoop;
-    for (int i = 0; i < mWorkers.size(); i++) {
-        if (mWorkers[i].idleLoopCount() > 0) {
+    for (int i = 0; i < workerCount(); i++) {
+        // a worker with queued tasks is about to wake up, it is not idle.
+        if (mWorkers[i].idleLoopCount() > 0 && mWorkers[i].queuedTaskCount() == 0) {
             workerIdleLoop.push_back(std::make_pair(i, mWorkers[i].idleLoopCount()));
         }
     }
@@ -252,8 +673,8 @@ auto ThreadPool::pickWorkerIdByQueueSize(const int idx) -> int {
         return -1;
     }
     std::vector<std::pair<int, int>> workerQueueSize;
-    for (int i = 0; i < mWorkers.size(); i++) {
-        workerQueueSize.push_back(std::make_pair(i, mWorkers[i].taskQueue().size()));
+    for (int i = 0; i < workerCount(); i++) {
+        workerQueueSize.push_back(std::make_pair(i, mWorkers[i].queuedTaskCount()));
     }
     std::sort(workerQueueSize.begin(), workerQueueSize.end(),
               [](const auto& a, const auto& b) { return a.second < b.second; });
@@ -267,16 +688,142 @@ auto ThreadPool::pickWorkerIdByQueueSize(const int idx) -> int {
     }
 }
 
+auto ThreadPool::pickWorkerIdByAffinity(const uint64_t affinityKey) -> int {
+    // mix the bits first, keys are often aligned addresses or small consecutive ids.
+    uint64_t hash = affinityKey;
+    hash          = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash          = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash          = hash ^ (hash >> 31);
+    auto& worker  = mWorkers[hash % mWorkers.size()];
+    if (worker.queuedTaskCount() * 2 > worker.taskQueue().capacity()) {
+        return -1;
+    }
+    return worker.workerId();
+}
+
 auto ThreadPool::pickWorkerIdByRandom() -> int {
     std::vector<int> workerIdavalible;
-    for (int i = 0; i < mWorkers.size(); i++) {
-        if (mWorkers[i].taskQueue().size() < mWorkers[i].taskQueue().capacity()) {
+    for (int i = 0; i < workerCount(); i++) {
+        if (mWorkers[i].queuedTaskCount() < mWorkers[i].taskQueue().capacity()) {
             workerIdavalible.push_back(i);
         }
     }
+    if (workerIdavalible.empty()) {
+        return -1;
+    }
     return workerIdavalible[rand() % workerIdavalible.size()];
 }
 
+auto ThreadPool::scheduleDelayedTask(Clock::time_point timePoint, DelayedTask&& delayedTask, const bool restartTimer)
+    -> bool {
+    std::unique_lock<std::mutex> lock(mTimerMutex);
+    if (!restartTimer && mTimerExit) {
+        return false;
+    }
+    if (mTimers == nullptr) {
+        mTimers.reset(new TimerWheel<DelayedTask>());
+    }
+    mTimers->schedule(timePoint, std::move(delayedTask));
+    if (!mTimerThread.isRunning()) {
+        mTimerExit = false;
+        mTimerThread.setName("Timer");
+        mTimerThread.start(std::bind(&ThreadPool::runTimer, this));
+    } else if (timePoint < mTimerWakeUp) {
+        mTimerCondition.notify_one();
+    }
+    return true;
+}
+
+auto ThreadPool::fireDelayedTask(Clock::time_point deadline, DelayedTask delayedTask) -> void {
+    if (delayedTask.packed != nullptr) {
+        // its next token is due, a cancel request meanwhile is seen when it is placed.
+        placeTask(delayedTask.packed, std::move(delayedTask.task));
+        return;
+    }
+    if (delayedTask.promise->state() == TaskState::Cancelled) {
+        return;
+    }
+    if (delayedTask.period.count() == 0) {
+        TaskDescription desc = delayedTask.desc == nullptr ? TaskDescription() : std::move(*delayedTask.desc);
+        desc.promise         = delayedTask.promise;
+        if (distributeTask(std::move(delayedTask.task), std::move(desc)) == nullptr) {
+            LLWFLOWS_LOG_WARN("delayed task[{}] distribute failed, cancel it.", delayedTask.promise->taskId());
+            delayedTask.promise->cancel();
+        }
+        return;
+    }
+    if (delayedTask.lastRun == nullptr || (delayedTask.lastRun->state() != TaskState::Queuing &&
+                                           delayedTask.lastRun->state() != TaskState::Running &&
+                                           delayedTask.lastRun->state() != (TaskState)TaskDependsUnfinish &&
+                                           delayedTask.lastRun->state() != (TaskState)TaskRateLimited)) {
+        delayedTask.lastRun = distributeTask(delayedTask.task, TaskDescription(*delayedTask.desc));
+        if (delayedTask.lastRun != nullptr) {
+            delayedTask.lastRun->taskId(delayedTask.promise->taskId());
+        }
+    } else {
+        LLWFLOWS_DEBUG("periodic task[{}] skip a tick, last run is not finished.", delayedTask.promise->taskId());
+    }
+    // fixed rate, missed ticks are skipped instead of fired in a burst.
+    auto next = deadline + std::chrono::duration_cast<Clock::duration>(delayedTask.period);
+    auto now  = Clock::now();
+    if (next <= now) {
+        next += std::chrono::duration_cast<Clock::duration>(delayedTask.period) *
+                ((now - next) / delayedTask.period + 1);
+    }
+    std::unique_lock<std::mutex> lock(mTimerMutex);
+    if (!mTimerExit) {
+        mTimers->schedule(next, std::move(delayedTask));
+    } else {
+        delayedTask.promise->cancel();
+    }
+}
+
+auto ThreadPool::runTimer() -> void {
+    std::vector<std::pair<Clock::time_point, DelayedTask>> dueTasks;
+    std::unique_lock<std::mutex>                           lock(mTimerMutex);
+    while (!mTimerExit) {
+        mTimers->advance(Clock::now(), [&dueTasks](Clock::time_point deadline, DelayedTask&& delayedTask) {
+            dueTasks.emplace_back(deadline, std::move(delayedTask));
+        });
+        if (!dueTasks.empty()) {
+            // distribute without lock, so adding timers is not blocked by worker queues.
+            lock.unlock();
+            for (auto& [deadline, delayedTask] : dueTasks) {
+                fireDelayedTask(deadline, std::move(delayedTask));
+            }
+            dueTasks.clear();
+            lock.lock();
+            continue;
+        }
+        mTimerWakeUp = mTimers->nextExpiry();
+        if (mTimerWakeUp == Clock::time_point::max()) {
+            mTimerCondition.wait(lock);
+        } else {
+            mTimerCondition.wait_until(lock, mTimerWakeUp);
+        }
+    }
+}
+
+auto ThreadPool::stopTimer() -> void {
+    {
+        std::unique_lock<std::mutex> lock(mTimerMutex);
+        mTimerExit = true;
+        mTimerCondition.notify_one();
+    }
+    if (mTimerThread.isJoinable()) {
+        mTimerThread.join();
+    }
+    std::unique_lock<std::mutex> lock(mTimerMutex);
+    if (mTimers != nullptr) {
+        mTimers->clear([this](Clock::time_point, DelayedTask&& delayedTask) {
+            // a task waiting for a token is already outstanding, its closure is dropped with it and finishes it.
+            if (delayedTask.packed == nullptr) {
+                delayedTask.promise->cancel();
+            }
+        });
+    }
+}
+
 auto ThreadPool::workers() -> std::vector<ThreadWorker>& { return mWorkers; }
 
 auto ThreadPool::workers() const -> const std::vector<ThreadWorker>& { return mWorkers; }
@@ -1,36 +1,157 @@
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <mutex>
 
+#include "profiler.hpp"
+#include "ratelimiter.hpp"
+#include "reactor.hpp"
+#include "taskarena.hpp"
+#include "taskname.hpp"
 #include "thread.hpp"
 #include "threadworker.hpp"
+#include "timerwheel.hpp"
 
 LLWFLOWS_NS_BEGIN
 
+///> @brief lane of the worker queue the task waits in, the value is the lane index
 enum class TaskPriority { High, Normal, Low };
+static_assert(static_cast<int>(TaskPriority::Low) < ThreadWorker::kPriorityLevels, "a priority without lane");
+static_assert(static_cast<int>(TaskPriority::Normal) == ThreadWorker::kDefaultPriority, "default lane mismatch");
+class ExecutionPlan;
 
 struct TaskDescription {
-    std::string                               name            = {};
+    TaskName                                  name            = {};
     int                                       specifyWorkerId = -1;
     std::vector<std::shared_ptr<TaskPromise>> dependencies    = {};
     std::shared_ptr<TaskPromise>              promise         = nullptr;
     TaskPriority                              priority        = TaskPriority::Normal;
     int                                       retryCount      = 0;
+    /**
+     * soft placement hint, 0 for none. tasks with the same key (e.g. a shard id or the address of the data they touch)
+     * prefer the same worker, unlike specifyWorkerId they can still be stolen or spilled when that worker is loaded.
+     */
+    uint64_t affinityKey = 0;
+    ///> run the task belongs to, the packed description and the promise created by the pool are allocated from it.
+    std::shared_ptr<TaskArena> arena = nullptr;
+    ///> counted down once when the task is finished, done or cancelled.
+    std::shared_ptr<TaskLatch> latch = nullptr;
+    /**
+     * shared by the tasks of a class which must not start more often than its rate. a task finding no token when its
+     * dependencies are done goes back to the timer until the next token is due instead of holding its worker, it
+     * stays outstanding meanwhile. stopping the pool cancels the tasks still waiting for a token.
+     */
+    std::shared_ptr<RateLimiter> rateLimiter = nullptr;
+    /**
+     * a task added from a task of the pool goes to the worker-local queue, which runs before anything else queued.
+     * false queues it behind the other tasks instead, e.g. for a continuation which yields the worker.
+     */
+    bool spawnLocal = true;
 };
 class ThreadPool {
     enum TaskStateCustom {
         TaskDependsUnfinish = (int)TaskState::Custom + 1,
+        TaskRateLimited,
+    };
+    struct PackedTask;
+    struct DelayedTask {
+        std::function<void()>            task;
+        std::unique_ptr<TaskDescription> desc;  ///> nullptr for default description
+        std::shared_ptr<TaskPromise>     promise;
+        std::shared_ptr<TaskPromise>     lastRun;  ///> last run of periodic task
+        std::chrono::nanoseconds         period{0};
+        PackedTask*                      packed{nullptr};  ///> task waiting for a token, task is its closure when due
+    };
+    // what a worker runs, owned by the closure made once by packTask
+    struct PackedTask {
+        TaskDescription          desc;
+        std::function<void()>    func;
+        std::size_t              doneDependencies{0};  ///> dependencies before it are done, a retry scans from there
+        std::chrono::nanoseconds tokenWait{0};         ///> until its rate limiter has a token again
+    };
+    // the closure of a packed task, named so the worker handing it back for a retry can be recognized
+    struct PackedTaskRunner {
+        ThreadPool*                 pool;
+        std::shared_ptr<PackedTask> packed;
+        auto                        operator()() -> void { pool->runPackedTask(packed.get()); }
     };
 
 public:
+    using Clock = std::chrono::steady_clock;
+
+
     ThreadPool(size_t numThreads);
     virtual ~ThreadPool();
     auto addTask(std::function<void()> task, const TaskDescription& desc = TaskDescription())
         -> std::shared_ptr<TaskPromise>;
+    ///> @brief add task, the description (e.g. its dependencies) is moved instead of copied
+    auto addTask(std::function<void()> task, TaskDescription&& desc) -> std::shared_ptr<TaskPromise>;
+    /**
+     * @brief add task with the default description and no promise to keep, for executors
+     *
+     * @note
+     * it is placed directly without going through distributeTask(), so a subclass overriding that does not see it.
+     * @return int 0 on success, -1 if the pool refused it.
+     */
+    auto post(std::function<void()> task) -> int;
+    /**
+     * @brief record the tasks added to this pool by the calling thread into an execution plan instead of running them
+     *
+     * @return int -1 if the thread is already capturing
+     */
+    auto beginCapture() -> int;
+    /**
+     * @brief stop recording and freeze the tasks recorded into a plan, see ExecutionPlan
+     *
+     * @return std::shared_ptr<ExecutionPlan> nullptr if the thread is not capturing for this pool
+     */
+    auto endCapture() -> std::shared_ptr<ExecutionPlan>;
+    /**
+     * @brief add task which will be distributed to workers at timePoint
+     *
+     * @note
+     * the task is kept in a timer wheel serviced by one timer thread of this pool until it is due, so it does not
+     * occupy any worker while waiting. the returned promise is in Queuing state until then and can be cancelled.
+     */
+    auto addTaskAt(Clock::time_point timePoint, std::function<void()> task,
+                   const TaskDescription& desc = TaskDescription()) -> std::shared_ptr<TaskPromise>;
+    auto addTaskAfter(std::chrono::nanoseconds delay, std::function<void()> task,
+                      const TaskDescription& desc = TaskDescription()) -> std::shared_ptr<TaskPromise>;
+    /**
+     * @brief add task which run every period, the first run is after one period.
+     *
+     * @note
+     * the returned promise represent the whole series, it stay Queuing until cancelled, so cancel it to stop the task.
+     * a tick is skipped if the run of last tick is still not finished.
+     */
+    auto addPeriodicTask(std::chrono::nanoseconds period, std::function<void()> task,
+                         const TaskDescription& desc = TaskDescription()) -> std::shared_ptr<TaskPromise>;
     auto cancel(std::shared_ptr<TaskPromise> task) -> int;
+    /**
+     * @brief cancel task and all tasks depending on it in one pass
+     *
+     * queuing tasks are cancelled at once, running tasks see it by their CancellationToken and end as cancelled.
+     *
+     * @return int count of tasks asked to stop
+     */
+    auto cancelSubgraph(std::shared_ptr<TaskPromise> task) -> int;
+    /**
+     * @brief wait until task is finished
+     *
+     * @note called from a worker thread, the worker keeps running queued and stealable tasks meanwhile, so nested
+     * fork-join does not block the pool.
+     */
     auto wait(std::shared_ptr<TaskPromise> task) -> void;
+    /**
+     * @brief wait until all tasks are finished
+     *
+     * @note
+     * every finished task costs one load, prefer one TaskLatch counted down by all of them for a large fan-in.
+     */
+    auto waitAll(const std::vector<std::shared_ptr<TaskPromise>>& tasks) -> void;
     /**
      * @brief start workers in thread pool
      *
@@ -39,25 +160,96 @@ public:
      * @note
      * if enableWorkStealing is true, the thread pool will try to steal tasks from other threads when a thread is idle.
      * and you should not add task with specifyWorkerId, because all task may be stolen by other threads.
+     * tasks added from inside a task of this pool are pushed to the local LIFO queue of the current worker (unless
+     * TaskDescription::spawnLocal is false), other workers only steal them when they are idle. if the worker queue
+     * policy is single consumer (see LLWFLOWS_WORKER_QUEUE_POLICY), stealing is still enabled but only takes from the
+     * local queues, a warning is logged.
      *
      * @param enableWorkStealing
      */
     auto start(const bool enableWorkStealing = false) -> void;
+    /**
+     * @brief wait until no task is queued, running or pending on a dependency
+     *
+     * @note
+     * tasks still waiting in the timer are not counted until they are due.
+     */
+    auto waitIdle() -> void;
+    ///> @brief count of tasks queued, running or pending on a dependency
+    auto outstandingTaskCount() const -> int64_t;
+#ifdef __linux__
+    /**
+     * @brief epoll reactor of this pool, created by the first call
+     *
+     * @note
+     * callbacks of watched fds are not counted by waitIdle() until their fd is ready, like delayed tasks. stopping the
+     * pool stops the reactor and drops them.
+     */
+    auto reactor() -> Reactor&;
+#endif
+    /**
+     * @brief record every run of a task, dependency retry and steal into profiler, nullptr to stop
+     *
+     * @note
+     * set it while no task is in flight, the profiler is not synchronized with the workers reading it.
+     */
+    auto setProfiler(std::shared_ptr<Profiler> profiler) -> void;
+    auto profiler() const -> const std::shared_ptr<Profiler>&;
+    /**
+     * @brief set how long a queued task waits to be promoted by one priority level, 0 for strict priority
+     *
+     * @note
+     * every worker runs its High lane first, then Normal, then Low. a lane waiting behind busier ones ages, so under a
+     * steady stream of High work a Low task at the head of its lane runs at latest two intervals (plus the batch the
+     * worker already claimed) after its lane was last served, a backlog of n Low tasks on a worker drains in about
+     * n * (2 * interval + task duration).
+     */
+    auto setPriorityAging(const std::chrono::nanoseconds interval) -> void;
+    auto priorityAging() const -> std::chrono::nanoseconds;
+    ///> @brief stop all workers at once, tasks in queues are cancelled
     auto stop() -> void;
-    // FIXME:
-    // 任务在重试过程中有可能推到了其他线程，导致某些线程关闭，然后如果推到未执行的线程中，就会导致后续任务不再执行并退出。
+    /**
+     * @brief wait all tasks finished (including dependency retries and tasks waiting for a token), then stop all
+     * workers at once. delayed tasks which are not due yet are cancelled.
+     */
     auto stopAndwaitAll() -> void;
 
 protected:
-    // after task failed by deps, will retry distributeTask
-    virtual auto distributeTask(std::function<void()> task, const TaskDescription& desc)
-        -> std::shared_ptr<TaskPromise>;
+    ///> @brief pack a new task and place it, a task failed by deps is placed again by placeTask without repacking
+    virtual auto distributeTask(std::function<void()> task, TaskDescription&& desc) -> std::shared_ptr<TaskPromise>;
+    ///> @brief pick a worker for packed and queue its closure run there
+    auto placeTask(PackedTask* packed, std::function<void()> run) -> std::shared_ptr<TaskPromise>;
     virtual auto onWorkerIdle(const int workerId, const int IdleCount) -> void;
-    ///> @brief pack task to support some properties like retry, deps, etc. and update description info
-    auto packTask(std::function<void()> task, const TaskDescription& desc)
-        -> std::pair<std::function<void()>, TaskDescription*>;
-    auto addTaskImp(std::function<void()> task, TaskDescription& desc, const int workerId)
+    ///> @brief take a task for workerId from the local queues of other workers, or from the most loaded shared queue
+    virtual auto stealTask(const int workerId, Task& task) -> bool;
+    /**
+     * @brief wrap packed into the closure run by workers to support some properties like retry, deps, etc.
+     * @note it is called once per task, retries queue the same closure again by onTaskUnfinished.
+     */
+    auto packTask(PackedTask* packed) -> std::function<void()>;
+    ///> @brief body of the closure of packed: check its dependencies and token, then run it
+    auto runPackedTask(PackedTask* packed) -> void;
+    /**
+     * @brief take back a task a worker did not finish: a packed task which returned waiting for a dependency or a
+     * token is queued again, a cancelled node of an execution plan and a dropped slot of a task graph are skipped, a
+     * dropped drain of a strand lets the strand schedule again. false if the caller still has to release the task.
+     */
+    auto onTaskUnfinished(Task& task) -> bool;
+    ///> @brief local: push to the local queue of workerId, must be called from the thread of that worker
+    auto addTaskImp(std::function<void()> task, TaskDescription& desc, const int workerId, const bool local = false)
         -> std::shared_ptr<TaskPromise>;
+    ///> @brief remove the promise of desc from the dependents of its dependencies, their cancel can not reach it now
+    auto unregisterDependent(const TaskDescription& desc) -> void;
+    ///> @brief destroy a packed task, the memory is only freed if it is not from an arena
+    static auto releasePackedTask(PackedTask* packed) -> void;
+    ///> @brief count down the latch of a task which is not retried, release it and count it finished
+    auto finishPackedTask(PackedTask* packed) -> void;
+    ///> @brief keep packed and its closure in the timer until its next token is due, false if the timer is stopped
+    auto deferTask(PackedTask* packed, std::function<void()>& run) -> bool;
+    ///> @brief id of the worker running the calling thread, -1 if it is not a worker of this pool
+    auto currentWorkerId() const -> int;
+    ///> @brief wake one sleeping worker except workerId, so it can steal from the local queues
+    auto notifyIdleWorker(const int workerId) -> void;
     /**
      * @brief next worker id by loop
      *
@@ -71,17 +263,50 @@ protected:
     /// @brief The idx smaller the queue size more little
     auto pickWorkerIdByQueueSize(const int idx) -> int;
     auto pickWorkerIdByRandom() -> int;
+    ///> @brief preferred worker of the affinity key, -1 if its queue is over half full so the task should spill
+    auto pickWorkerIdByAffinity(const uint64_t affinityKey) -> int;
     auto workers() -> std::vector<ThreadWorker>&;
     auto workers() const -> const std::vector<ThreadWorker>&;
     auto workerCount() const -> int;
+    ///> @brief return false if restartTimer is false and the timer was stopped, delayedTask is left untouched then
+    auto scheduleDelayedTask(Clock::time_point timePoint, DelayedTask&& delayedTask, const bool restartTimer = true)
+        -> bool;
+    auto fireDelayedTask(Clock::time_point deadline, DelayedTask delayedTask) -> void;
+    auto runTimer() -> void;
+    ///> @brief stop timer thread, all pending delayed tasks are cancelled
+    auto stopTimer() -> void;
+    ///> @brief stop reactor thread, callbacks of fds not ready yet are dropped
+    auto stopReactor() -> void;
+    auto taskFinished() -> void;
+    ///> @brief signal all workers to exit, then join them, tasks left in queues are cancelled
+    auto shutdownWorkers(const bool afterTaskInQueue) -> void;
 
 private:
-#if LLWFLOWS_CPP_PLUS < 20
-    std::mutex              mMutex;
-    std::condition_variable mCondition;
-#endif
+    friend class ExecutionPlan;
+
     std::atomic<int>          mCurrentWorkerId{0};
     std::vector<ThreadWorker> mWorkers;
-    uint64_t                  mTaskCount{0};
+    std::atomic<uint64_t>     mTaskCount{0};
+    bool                      mWorkStealing{false};
+    std::shared_ptr<Profiler> mProfiler;
+    // termination detection: outstanding tasks and an epoch bumped every time it drop to zero
+    std::atomic<int64_t>  mOutstandingTasks{0};
+    std::atomic<uint32_t> mIdleEpoch{0};
+    std::atomic<int>      mIdleWaiters{0};
+    std::atomic<bool>     mStopping{false};
+    // latches tasks of this pool are parked on, released when it stops
+    std::mutex                            mParkedMutex;
+    std::vector<std::weak_ptr<TaskLatch>> mParkedLatches;
+    // timer
+    std::mutex                               mTimerMutex;
+    std::condition_variable                  mTimerCondition;
+    std::unique_ptr<TimerWheel<DelayedTask>> mTimers;
+    Thread                                   mTimerThread;
+    bool                                     mTimerExit{false};
+    Clock::time_point                        mTimerWakeUp{Clock::time_point::max()};
+#ifdef __linux__
+    std::mutex               mReactorMutex;
+    std::unique_ptr<Reactor> mReactor;
+#endif
 };
 LLWFLOWS_NS_END
\ No newline at end of file
@@ -1,13 +1,48 @@
 #include "threadworker.hpp"
 
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+#include "detail/futex.hpp"
 #include "detail/log.hpp"
 
 LLWFLOWS_NS_BEGIN
+static thread_local TaskPromise*  kCurrentTaskPromise = nullptr;
+static thread_local ThreadWorker* kCurrentWorker      = nullptr;
+static constexpr int              kWorkerEntryBits    = 16;
+static constexpr uint64_t         kWorkerEntryMask    = (uint64_t(1) << kWorkerEntryBits) - 1;
+static_assert(TaskPromise::kWorkerHistorySize * kWorkerEntryBits <= 64, "worker history must fit in one word");
+static_assert(ThreadWorker::kPriorityLevels == 3, "the lanes are initialized one by one");
+
+static auto steadyNow() -> int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
 auto TaskPromise::state() const -> TaskState { return mState.load(std::memory_order_release); }
 
 auto TaskPromise::workerId() const -> int { return mWorkerId.load(std::memory_order_release); }
 
-auto TaskPromise::workerIds() const -> const std::vector<int>& { return mWorkerIds; }
+auto TaskPromise::firstWorkerId() const -> int { return mFirstWorkerId.load(std::memory_order_acquire); }
+
+auto TaskPromise::lastWorkerId() const -> int {
+    return static_cast<int>(mWorkerHistory.load(std::memory_order_acquire) & kWorkerEntryMask) - 1;
+}
+
+auto TaskPromise::workerHistory() const -> std::array<int, kWorkerHistorySize> {
+    std::array<int, kWorkerHistorySize> ids;
+    auto                                history = mWorkerHistory.load(std::memory_order_acquire);
+    for (auto& id : ids) {
+        id = static_cast<int>(history & kWorkerEntryMask) - 1;
+        history >>= kWorkerEntryBits;
+    }
+    return ids;
+}
+
+auto TaskPromise::placementCount() const -> uint32_t { return mPlacementCount.load(std::memory_order_relaxed); }
+
+auto TaskPromise::migrationCount() const -> uint32_t { return mMigrationCount.load(std::memory_order_relaxed); }
 
 auto TaskPromise::cancel() -> int {
     auto taskState = mState.load(std::memory_order_release);
@@ -16,19 +51,121 @@ auto TaskPromise::cancel() -> int {
         if (taskState != TaskState::Queuing) {
             return -1;
         }
-    } while (!mState.compare_exchange_weak(taskState, TaskState::Cancelled, std::memory_order_release,
+    } while (!mState.compare_exchange_weak(taskState, TaskState::Cancelled, std::memory_order_seq_cst,
                                            std::memory_order_relaxed));
-#if LLWFLOWS_CPP_PLUS >= 20
-    notifyAll();
-#endif
+    wakeWaiters();
     return 0;
 }
 
+auto TaskPromise::requestCancel(const bool withDependents) -> int {
+    int                                       count = 0;
+    std::vector<std::shared_ptr<TaskPromise>> pending;
+    std::vector<std::weak_ptr<TaskPromise>>   dependents;
+    std::shared_ptr<TaskPromise>              holder;  // keep the visiting dependent alive
+    TaskPromise*                              promise = this;
+    while (true) {
+        // every promise is marked once, so the walk is O(tasks + edges) of the downstream subgraph.
+        if (!promise->mCancelRequested.exchange(true)) {
+            ++count;
+            promise->cancel();
+            promise->onCancelRequested();
+            if (withDependents) {
+                {
+                    std::lock_guard<detail::SpinLock> lock(promise->mDependentsLock);
+                    dependents.swap(promise->mDependents);
+                }
+                for (auto& dependent : dependents) {
+                    if (auto ptr = dependent.lock(); ptr != nullptr) {
+                        pending.push_back(std::move(ptr));
+                    }
+                }
+                dependents.clear();
+            }
+        }
+        if (pending.empty()) {
+            break;
+        }
+        holder = std::move(pending.back());
+        pending.pop_back();
+        promise = holder.get();
+    }
+    return count;
+}
+
+auto TaskPromise::isCancelRequested() const -> bool { return mCancelRequested.load(std::memory_order_acquire); }
+
+auto TaskPromise::cancellationToken() const -> CancellationToken { return CancellationToken(&mCancelRequested); }
+
+auto TaskPromise::addDependent(std::weak_ptr<TaskPromise> dependent) -> int {
+    std::lock_guard<detail::SpinLock> lock(mDependentsLock);
+    if (mCancelRequested.load(std::memory_order_acquire)) {
+        return -1;
+    }
+    // the expired ones are dropped before the list doubles, so it stays as long as the live ones.
+    if (mDependents.size() == mDependents.capacity()) {
+        mDependents.erase(std::remove_if(mDependents.begin(), mDependents.end(),
+                                         [](const std::weak_ptr<TaskPromise>& item) { return item.expired(); }),
+                          mDependents.end());
+    }
+    mDependents.push_back(std::move(dependent));
+    return 0;
+}
+
+auto TaskPromise::removeDependent(const TaskPromise* dependent) -> void {
+    std::lock_guard<detail::SpinLock> lock(mDependentsLock);
+    // dependents mostly finish in the order they were added, the entry is found near the front.
+    auto iter = std::find_if(mDependents.begin(), mDependents.end(),
+                             [dependent](const std::weak_ptr<TaskPromise>& item) {
+                                 return !item.expired() && item.lock().get() == dependent;
+                             });
+    if (iter != mDependents.end()) {
+        mDependents.erase(iter);
+    }
+}
+
+auto TaskPromise::dependentCount() -> std::size_t {
+    std::lock_guard<detail::SpinLock> lock(mDependentsLock);
+    return mDependents.size();
+}
+
 auto TaskPromise::mutableState() -> std::atomic<TaskState>& { return mState; }
 
 auto TaskPromise::mutableWorkerId() -> std::atomic<int>& { return mWorkerId; }
 
-auto TaskPromise::mutableWorkerIds() -> std::vector<int>& { return mWorkerIds; }
+auto TaskPromise::recordWorker(const int workerId) -> uint64_t {
+    auto entry   = static_cast<uint64_t>(workerId + 1) & kWorkerEntryMask;
+    auto history = mWorkerHistory.load(std::memory_order_relaxed);
+    // the oldest entry is shifted out.
+    while (!mWorkerHistory.compare_exchange_weak(history, (history << kWorkerEntryBits) | entry,
+                                                 std::memory_order_acq_rel, std::memory_order_relaxed)) {
+    }
+    auto last = history & kWorkerEntryMask;
+    if (last == 0) {
+        mFirstWorkerId.store(workerId, std::memory_order_release);
+    } else if (last != entry) {
+        mMigrationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    mPlacementCount.fetch_add(1, std::memory_order_relaxed);
+    return history;
+}
+
+auto TaskPromise::restoreWorkerHistory(const uint64_t history) -> void {
+    auto entry = mWorkerHistory.exchange(history, std::memory_order_acq_rel) & kWorkerEntryMask;
+    auto last  = history & kWorkerEntryMask;
+    if (last == 0) {
+        mFirstWorkerId.store(-1, std::memory_order_release);
+    } else if (last != entry) {
+        mMigrationCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    mPlacementCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+auto TaskPromise::resetWorkerHistory() -> void {
+    mWorkerHistory.store(0, std::memory_order_release);
+    mFirstWorkerId.store(-1, std::memory_order_release);
+    mPlacementCount.store(0, std::memory_order_relaxed);
+    mMigrationCount.store(0, std::memory_order_relaxed);
+}
 
 auto TaskPromise::changeState(const TaskState old, const TaskState newState) -> int {
     auto taskState = mState.load(std::memory_order_release);
@@ -37,10 +174,8 @@ auto TaskPromise::changeState(const TaskState old, const TaskState newState) ->
         if (taskState != old) {
             return -1;
         }
-    } while (!mState.compare_exchange_weak(taskState, newState, std::memory_order_release, std::memory_order_relaxed));
-#if LLWFLOWS_CPP_PLUS >= 20
-    notifyAll();
-#endif
+    } while (!mState.compare_exchange_weak(taskState, newState, std::memory_order_seq_cst, std::memory_order_relaxed));
+    wakeWaiters();
     return 0;
 }
 
@@ -63,11 +198,9 @@ auto TaskPromise::done() -> int {
         if (taskState != TaskState::Running) {
             return -1;
         }
-    } while (!mState.compare_exchange_weak(taskState, TaskState::Done, std::memory_order_release,
+    } while (!mState.compare_exchange_weak(taskState, TaskState::Done, std::memory_order_seq_cst,
                                            std::memory_order_relaxed));
-#if LLWFLOWS_CPP_PLUS >= 20
-    notifyAll();
-#endif
+    wakeWaiters();
     return 0;
 }
 
@@ -79,21 +212,136 @@ auto TaskPromise::taskId() -> uint64_t { return mTaskId; }
 
 auto TaskPromise::taskId(uint64_t id) -> void { mTaskId = id; }
 
-#if LLWFLOWS_CPP_PLUS >= 20
-auto TaskPromise::wait() -> TaskState {
-    while (mState.load(std::memory_order_release) == TaskState::Queuing ||
-           mState.load(std::memory_order_release) == TaskState::Running) {
-        mState.wait(TaskState::Queuing, std::memory_order_acquire);
-        mState.wait(TaskState::Running, std::memory_order_acquire);
+auto TaskPromise::wait() -> TaskState { return waitUntil(detail::kNoDeadline); }
+
+auto TaskPromise::waitFor(const std::chrono::nanoseconds timeout) -> TaskState {
+    // clamped, so a huge timeout does not overflow the deadline.
+    auto left = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::min<std::chrono::nanoseconds>(timeout, std::chrono::hours(24 * 365)));
+    return waitUntil(std::chrono::steady_clock::now() + left);
+}
+
+auto TaskPromise::waitUntil(const std::chrono::steady_clock::time_point deadline) -> TaskState {
+    auto isPending = [](const TaskState state) { return state != TaskState::Done && state != TaskState::Cancelled; };
+    const bool timed = deadline != detail::kNoDeadline;
+    if (auto worker = ThreadWorker::currentWorker(); worker != nullptr) {
+        auto pending = [this, &isPending, timed, deadline]() {
+            return isPending(mState.load(std::memory_order_acquire)) &&
+                   (!timed || std::chrono::steady_clock::now() < deadline);
+        };
+        // the awaited task may wait for something outside the pool, the worker then sleeps on the state by slices and
+        // looks for work to steal in between, a task posted to it or the transition wakes it at once.
+        auto block = [this, &isPending, worker, deadline]() {
+            mWaiters.fetch_add(1, std::memory_order_seq_cst);
+            auto taskState = mState.load(std::memory_order_seq_cst);
+            if (isPending(taskState)) {
+                auto slice = std::chrono::steady_clock::now() + ThreadWorker::kHelpBlockSlice;
+                worker->blockOn(mState, taskState, std::min(slice, deadline));
+            }
+            mWaiters.fetch_sub(1, std::memory_order_relaxed);
+        };
+        worker->helpWhile(pending, block);
+        return mState.load(std::memory_order_acquire);
+    }
+    auto taskState = mState.load(std::memory_order_acquire);
+    if (!isPending(taskState)) {
+        return taskState;
+    }
+    // counted before the state is read again, so a transition either is seen here or sees the waiter and wakes it.
+    mWaiters.fetch_add(1, std::memory_order_seq_cst);
+    while (isPending(taskState = mState.load(std::memory_order_seq_cst)) &&
+           (!timed || std::chrono::steady_clock::now() < deadline)) {
+        // the futex returns at once if the state moved on since it was read, no transition is missed.
+        detail::futexWait(mState, taskState, deadline);
+    }
+    mWaiters.fetch_sub(1, std::memory_order_relaxed);
+    return taskState;
+}
+
+auto TaskPromise::waiterCount() const -> int { return static_cast<int>(mWaiters.load(std::memory_order_relaxed)); }
+
+auto TaskPromise::notifyOne() -> void { detail::futexWakeOne(mState); }
+
+auto TaskPromise::notifyAll() -> void { detail::futexWakeAll(mState); }
+
+auto TaskPromise::wakeWaiters() -> void {
+    // the state was changed by a seq_cst CAS, so this load can not miss a waiter which did not see the new state.
+    if (mWaiters.load(std::memory_order_seq_cst) != 0) {
+        detail::futexWakeAll(mState);
+    }
+}
+
+TaskLatch::TaskLatch(const int64_t count) noexcept : mCount(count) {
+    mutableState().store(count > 0 ? TaskState::Running : TaskState::Done, std::memory_order_release);
+}
+
+auto TaskLatch::create(const int64_t count) -> std::shared_ptr<TaskLatch> { return std::make_shared<TaskLatch>(count); }
+
+auto TaskLatch::countDown(const int64_t n) -> int64_t {
+    auto left = mCount.fetch_sub(n, std::memory_order_acq_rel) - n;
+    if (left <= 0 && left + n > 0) {
+        done();
+        releaseParked();
+    }
+    return left;
+}
+
+auto TaskLatch::add(const int64_t n) -> int {
+    auto count = mCount.load(std::memory_order_acquire);
+    do {
+        // done is final, a count down to zero may already have released the dependents.
+        if (count <= 0) {
+            return -1;
+        }
+    } while (!mCount.compare_exchange_weak(count, count + n, std::memory_order_acq_rel, std::memory_order_acquire));
+    return 0;
+}
+
+auto TaskLatch::count() const -> int64_t { return mCount.load(std::memory_order_acquire); }
+
+auto TaskLatch::onDone(std::function<void()> func) -> int {
+    {
+        std::lock_guard<detail::SpinLock> lock(mParkedLock);
+        // checked under the lock, so a function is either parked before the release or called here.
+        if (!mReleased) {
+            mParked.push_back(std::move(func));
+            return static_cast<int>(mParked.size()) - 1;
+        }
+    }
+    func();
+    return -1;
+}
+
+auto TaskLatch::parkedCount() -> std::size_t {
+    std::lock_guard<detail::SpinLock> lock(mParkedLock);
+    return mParked.size();
+}
+
+auto TaskLatch::onCancelRequested() -> void { releaseParked(); }
+
+auto TaskLatch::releaseParked() -> void {
+    std::vector<std::function<void()>> parked;
+    {
+        std::lock_guard<detail::SpinLock> lock(mParkedLock);
+        if (mReleased) {
+            return;
+        }
+        mReleased = true;
+        parked.swap(mParked);
+    }
+    // called without the lock, a function may park on another latch or count this one down again.
+    for (auto& func : parked) {
+        func();
     }
-    return mState.load(std::memory_order_release);
 }
-auto TaskPromise::notifyOne() -> void { mState.notify_one(); }
-auto TaskPromise::notifyAll() -> void { mState.notify_all(); }
-#endif
 
 ThreadWorker::ThreadWorker(const int workerId, const int maxQueueSize, const int maxIdleLoopCount)
-    : mWorkerId(workerId), mTasks(maxQueueSize), mMaxIdleLoopCount(maxIdleLoopCount) {
+    : mWorkerId(workerId),
+      mTasks{{static_cast<std::size_t>(maxQueueSize)},
+             {static_cast<std::size_t>(maxQueueSize)},
+             {static_cast<std::size_t>(maxQueueSize)}},
+      mLocalTasks(maxQueueSize),
+      mMaxIdleLoopCount(maxIdleLoopCount) {
     init(workerId);
 }
 
@@ -125,27 +373,50 @@ auto ThreadWorker::workerId() const -> int { return mWorkerId; }
 
 auto ThreadWorker::post(std::function<void()> func) -> std::shared_ptr<TaskPromise> {
     auto promise = std::make_shared<TaskPromise>();
-    promise->mutableWorkerIds().push_back(mWorkerId);
-    if (mTasks.push({std::move(func), promise})) {
-        mConditionVar.notify_one();
+    if (post(Task{std::move(func), promise}) == 0) {
         return promise;
     }
-    LLWFLOWS_LOG_WARN("Worker id({}) post task failed.", mWorkerId);
     return nullptr;
 }
 
 auto ThreadWorker::post(std::function<void()> func, std::shared_ptr<TaskPromise> taskPromise) -> int {
-    taskPromise->mutableWorkerIds().push_back(mWorkerId);
-    if (mTasks.push({std::move(func), taskPromise})) {
-        mConditionVar.notify_one();
+    return post(Task{std::move(func), std::move(taskPromise)});
+}
+
+auto ThreadWorker::post(Task&& task, const int priority) -> int {
+    auto& lane = mTasks[std::min(std::max(priority, 0), kPriorityLevels - 1)];
+    // recorded before the push, once queued the task may already be run and re-posted by a worker.
+    auto history = task.taskPromise->recordWorker(mWorkerId);
+    if (lane.push(std::move(task))) {
+        wakeUp();
+        return 0;
+    }
+    task.taskPromise->restoreWorkerHistory(history);
+    LLWFLOWS_LOG_WARN("Worker id({}) post task failed. priority: {}, queue size: {}, capacity: {}", mWorkerId, priority,
+                      lane.size(), lane.capacity());
+    return -1;
+}
+
+auto ThreadWorker::postLocal(Task&& task) -> int {
+    auto history = task.taskPromise->recordWorker(mWorkerId);
+    if (mLocalTasks.push_back(std::move(task))) {
         return 0;
     }
-    taskPromise->mutableWorkerIds().pop_back();
-    LLWFLOWS_LOG_WARN("Worker id({}) post task failed. queue size: {}, capacity: {}", mWorkerId, mTasks.size(),
-                      mTasks.capacity());
+    task.taskPromise->restoreWorkerHistory(history);
     return -1;
 }
 
+auto ThreadWorker::stealLocal(Task& task) -> bool { return mLocalTasks.steal(task); }
+
+auto ThreadWorker::localTaskCount() const -> int { return static_cast<int>(mLocalTasks.size()); }
+
+auto ThreadWorker::notifyIdle() -> void {
+    mIdleNotified.store(true, std::memory_order_relaxed);
+    wakeUp();
+}
+
+auto ThreadWorker::isSleeping() const -> bool { return mSleeping.load(std::memory_order_relaxed); }
+
 auto ThreadWorker::waitForExit() -> void {
     if (isJoinable() && (mExit.load(std::memory_order_release) || mExitAfterAllTasks.load(std::memory_order_release))) {
         join();
@@ -158,12 +429,104 @@ auto ThreadWorker::exit(bool AfterTaskInQueue) -> void {
     } else {
         mExit.store(true, std::memory_order_release);
     }
-    if (mTasks.size() == 0) {
+    wakeUp();
+}
+
+auto ThreadWorker::wakeUp() -> void {
+    // pairs with the fence in run(), either the worker sees the new state before sleeping or we see it sleeping.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mSleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(mMutex);
         mConditionVar.notify_one();
     }
+    // same pairing with the fence in blockOn(), the word is only used under the lock so it is still alive here.
+    if (mHelpBlocked.load(std::memory_order_relaxed)) {
+        std::lock_guard<detail::SpinLock> lock(mHelpBlockLock);
+        if (mHelpBlockWord != nullptr) {
+            detail::futexWakeAll(*mHelpBlockWord);
+        }
+    }
+}
+
+auto ThreadWorker::taskQueue(const int priority) -> TaskQueue& {
+    return mTasks[std::min(std::max(priority, 0), kPriorityLevels - 1)];
 }
 
-auto ThreadWorker::taskQueue() -> SRingBuffer<Task>& { return mTasks; }
+auto ThreadWorker::queuedTaskCount() const -> std::size_t {
+    std::size_t count = 0;
+    for (auto& lane : mTasks) {
+        count += lane.size();
+    }
+    return count;
+}
+
+auto ThreadWorker::queuesEmpty() const -> bool {
+    for (auto& lane : mTasks) {
+        if (!lane.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto ThreadWorker::pickLane(bool& aged) -> int {
+    aged        = false;
+    int first   = -1;
+    int waiting = 0;
+    for (int i = 0; i < kPriorityLevels; ++i) {
+        if (!mTasks[i].empty()) {
+            first = first == -1 ? i : first;
+            ++waiting;
+        }
+    }
+    const auto interval = mAgingInterval.load(std::memory_order_relaxed);
+    if (waiting <= 1 || interval <= 0) {
+        return first;
+    }
+    // the effective priority is the level less the levels gained by waiting, kept in ns to avoid a division.
+    const auto now  = steadyNow();
+    int        lane = first;
+    int64_t    best = std::numeric_limits<int64_t>::max();
+    for (int i = first; i < kPriorityLevels; ++i) {
+        if (mTasks[i].empty()) {
+            continue;
+        }
+        auto since = mLaneWaitSince[i].load(std::memory_order_relaxed);
+        if (since == 0 && mLaneWaitSince[i].compare_exchange_strong(since, now, std::memory_order_relaxed)) {
+            since = now;
+        }
+        if (auto effective = i * interval - (now - since); effective < best) {
+            best = effective;
+            lane = i;
+        }
+    }
+    aged = lane != first;
+    return lane;
+}
+
+auto ThreadWorker::popBatch(Task* tasks, const std::size_t count) -> std::size_t {
+    bool aged = false;
+    auto lane = pickLane(aged);
+    if (lane == -1) {
+        return 0;
+    }
+    auto popped = mTasks[lane].try_pop_n(tasks, aged ? 1 : count);
+    if (popped > 0) {
+        // the lane was served, its next task waits from the next time the lanes compete.
+        mLaneWaitSince[lane].store(0, std::memory_order_relaxed);
+    }
+    return popped;
+}
+
+auto ThreadWorker::pop(Task& task) -> bool { return popBatch(&task, 1) == 1; }
+
+auto ThreadWorker::setAgingInterval(const std::chrono::nanoseconds interval) -> void {
+    mAgingInterval.store(std::max<int64_t>(interval.count(), 0), std::memory_order_relaxed);
+}
+
+auto ThreadWorker::agingInterval() const -> std::chrono::nanoseconds {
+    return std::chrono::nanoseconds(mAgingInterval.load(std::memory_order_relaxed));
+}
 
 auto ThreadWorker::idleLoopCount() -> int { return mIdleLoopCount; }
 
@@ -173,6 +536,60 @@ auto ThreadWorker::registerCallbackInIdleLoop(std::function<void(const int workI
     mCallbackInIdleLoop = func;
 }
 
+auto ThreadWorker::registerStealCallback(std::function<bool(const int workId, Task& task)> func) -> void {
+    mStealCallback = func;
+}
+
+auto ThreadWorker::registerUnfinishedCallback(std::function<bool(const int workId, Task& task)> func) -> void {
+    mUnfinishedCallback = func;
+}
+
+auto ThreadWorker::helpWhile(const std::function<bool()>& pending, const std::function<void()>& block) -> void {
+    int spin = 0;
+    int idle = 0;
+    while (pending()) {
+        Task task;
+        if (mLocalTasks.pop_back(task) || pop(task) || (mStealCallback && mStealCallback(mWorkerId, task))) {
+            spin = 0;
+            idle = 0;
+            if (mExit) {
+                // the worker is stopping, what it takes is cancelled as in run().
+                dropTask(task);
+            } else {
+                runTask(task);
+            }
+            continue;
+        }
+        // nothing to run, the awaited task is running on another worker or waits for something outside the pool.
+        if (++spin > 64) {
+            spin = 0;
+            if (block && ++idle > 16) {
+                idle = 0;
+                block();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+auto ThreadWorker::blockOn(std::atomic<TaskState>& word, const TaskState expected,
+                           const std::chrono::steady_clock::time_point deadline) -> void {
+    {
+        std::lock_guard<detail::SpinLock> lock(mHelpBlockLock);
+        mHelpBlockWord = &word;
+    }
+    mHelpBlocked.store(true, std::memory_order_relaxed);
+    // pairs with the fence in wakeUp(), either a post sees the worker blocked or the worker sees the posted task.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (queuesEmpty() && !mExit.load(std::memory_order_relaxed)) {
+        detail::futexWait(word, expected, deadline);
+    }
+    mHelpBlocked.store(false, std::memory_order_relaxed);
+    std::lock_guard<detail::SpinLock> lock(mHelpBlockLock);
+    mHelpBlockWord = nullptr;
+}
+
 auto ThreadWorker::isIdle() -> bool {
     if (mIdleLoopCount.load(std::memory_order_release) >= mMaxIdleLoopCount) {
         return true;
@@ -180,50 +597,122 @@ auto ThreadWorker::isIdle() -> bool {
     return false;
 }
 
+auto ThreadWorker::setBatchSize(const int batchSize) -> void {
+    mBatchSize.store(std::min(std::max(batchSize, 1), kMaxBatchSize), std::memory_order_relaxed);
+}
+
+auto ThreadWorker::batchSize() const -> int { return mBatchSize.load(std::memory_order_relaxed); }
+
+auto ThreadWorker::currentTaskPromise() -> TaskPromise* { return kCurrentTaskPromise; }
+
+auto ThreadWorker::currentWorker() -> ThreadWorker* { return kCurrentWorker; }
+
+auto ThreadWorker::currentCancellationToken() -> CancellationToken {
+    if (kCurrentTaskPromise == nullptr) {
+        return CancellationToken();
+    }
+    return kCurrentTaskPromise->cancellationToken();
+}
+
+auto ThreadWorker::runTask(Task& task) -> void {
+    auto taskState = task.taskPromise->mutableState().load(std::memory_order_release);
+    while (true) {
+        if (taskState == TaskState::Queuing) {
+            if (task.taskPromise->mutableState().compare_exchange_weak(
+                    taskState, TaskState::Running, std::memory_order_release, std::memory_order_relaxed)) {
+                task.taskPromise->mutableWorkerId() = mWorkerId;
+                auto lastTaskPromise                = kCurrentTaskPromise;
+                kCurrentTaskPromise                 = task.taskPromise.get();
+                task.func();
+                kCurrentTaskPromise = lastTaskPromise;
+                // a task asked to stop while running ends as cancelled, so its dependents will not run.
+                if (task.taskPromise->isCancelRequested()) {
+                    task.taskPromise->changeState(TaskState::Running, TaskState::Cancelled);
+                } else {
+                    task.taskPromise->done();
+                }
+                // a task waiting for something (e.g. a retry of its pool) is handed back instead of dropped.
+                if (mUnfinishedCallback && (int)task.taskPromise->state() > (int)TaskState::Custom) {
+                    mUnfinishedCallback(mWorkerId, task);
+                }
+                break;
+            }
+        } else {
+            // cancelled while queued, its owner may still count on it.
+            if (mUnfinishedCallback && taskState == TaskState::Cancelled) {
+                mUnfinishedCallback(mWorkerId, task);
+            }
+            break;
+        }
+    }
+}
+
+auto ThreadWorker::dropTask(Task& task) -> void {
+    task.taskPromise->mutableWorkerId() = mWorkerId;
+    task.taskPromise->cancel();
+    if (mUnfinishedCallback) {
+        mUnfinishedCallback(mWorkerId, task);
+    }
+}
+
 void ThreadWorker::run() {
+    kCurrentWorker = this;
+    Task batch[kMaxBatchSize];
     while (!mExit) {
-        Task task;
-        if (mTasks.pop(task)) {
+        // tasks spawned by the tasks of this worker run first, newest first, while their data is still in cache.
+        if (mLocalTasks.pop_back(batch[0])) {
             mIdleLoopCount.store(0, std::memory_order_release);
-            auto taskState = task.taskPromise->mutableState().load(std::memory_order_release);
-            while (true) {
-                if (taskState == TaskState::Queuing) {
-                    if (task.taskPromise->mutableState().compare_exchange_weak(
-                            taskState, TaskState::Running, std::memory_order_release, std::memory_order_relaxed)) {
-                        task.taskPromise->mutableWorkerId() = mWorkerId;
-                        task.func();
-                        task.taskPromise->done();
-                        break;
-                    }
-                } else {
-                    break;
-                }
+            runTask(batch[0]);
+            batch[0] = Task();
+            continue;
+        }
+        const auto batchSize = static_cast<std::size_t>(mBatchSize.load(std::memory_order_relaxed));
+        const auto count     = popBatch(batch, batchSize);
+        if (count > 0) {
+            mIdleLoopCount.store(0, std::memory_order_release);
+            std::size_t idx = 0;
+            for (; idx < count && !mExit; ++idx) {
+                runTask(batch[idx]);
+                batch[idx] = Task();
+            }
+            // exit in the middle of a batch, the claimed tasks are cancelled as the ones left in the queue.
+            for (; idx < count; ++idx) {
+                dropTask(batch[idx]);
+                batch[idx] = Task();
             }
-        } else if (mTasks.size() == 0) {
+        } else if (queuesEmpty()) {
             mIdleLoopCount.fetch_add(1, std::memory_order_release);
             if (mCallbackInIdleLoop) {
                 mCallbackInIdleLoop(mWorkerId, mIdleLoopCount.load(std::memory_order_release));
             }
-            if (mExitAfterAllTasks && mTasks.size() == 0) {
+            if (mExitAfterAllTasks && queuesEmpty() && mLocalTasks.empty()) {
                 mExit.store(true, std::memory_order_release);
                 break;
             }
             if (mIdleLoopCount.load(std::memory_order_release) > mMaxIdleLoopCount) {
                 std::unique_lock<std::mutex> lock(mMutex);
-                while (mTasks.empty() && !mExit && !mExitAfterAllTasks) {
-                    mConditionVar.wait(lock, [this]() { return mExit || !mTasks.empty() || mExitAfterAllTasks; });
+                mSleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                while (queuesEmpty() && !mExit && !mExitAfterAllTasks && !mIdleNotified) {
+                    mConditionVar.wait(
+                        lock, [this]() { return mExit || !queuesEmpty() || mExitAfterAllTasks || mIdleNotified; });
                 }
+                mSleeping.store(false, std::memory_order_relaxed);
+                mIdleNotified.store(false, std::memory_order_relaxed);
                 mIdleLoopCount.store(0, std::memory_order_release);
             }
         }
     }
-    while (mTasks.size() > 0) {
-        Task task;
-        if (mTasks.pop(task)) {
-            task.taskPromise->mutableWorkerId() = mWorkerId;
-            task.taskPromise->cancel();
+    Task task;
+    for (auto& lane : mTasks) {
+        while (lane.pop(task)) {
+            dropTask(task);
         }
     }
+    while (mLocalTasks.pop_back(task)) {
+        dropTask(task);
+    }
+    kCurrentWorker = nullptr;
 }
 
 LLWFLOWS_NS_END
@@ -1,27 +1,100 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <future>
 #include <mutex>
 #include <vector>
 
+#include "detail/spinlock.hpp"
+#include "detail/workstealingdeque.hpp"
 #include "sringbuffer.hpp"
 #include "thread.hpp"
 
+/**
+ * @brief policy of the task queue of ThreadWorker
+ *
+ * tasks are posted by any thread and popped by the owner worker and by other workers stealing from it, so it is MPMC
+ * by default. a build that never enables work stealing can define it to policy::MPSC to save the CAS on pop.
+ */
+#ifndef LLWFLOWS_WORKER_QUEUE_POLICY
+#define LLWFLOWS_WORKER_QUEUE_POLICY policy::MPMC
+#endif
+
 LLWFLOWS_NS_BEGIN
 
 enum class TaskState { Queuing = 0, Running, Done, Cancelled, Custom = 0x8000 };
 
+/**
+ * @brief cheap handle for a running task to poll if it is asked to stop
+ *
+ * @note it does not own the flag, it is valid as long as the TaskPromise it comes from is alive.
+ * the task which is running always keeps its promise alive, so it is safe to use it inside the task.
+ */
+class CancellationToken {
+public:
+    CancellationToken() noexcept = default;
+    explicit CancellationToken(const std::atomic<bool>* flag) noexcept : mFlag(flag) {}
+    inline auto isCancelled() const noexcept -> bool {
+        return mFlag != nullptr && mFlag->load(std::memory_order_relaxed);
+    }
+
+private:
+    const std::atomic<bool>* mFlag = nullptr;
+};
+
 class TaskPromise {
 public:
+    ///> @brief count of the last workers a task was queued to kept by its promise
+    static constexpr int kWorkerHistorySize = 4;
+
     TaskPromise() noexcept = default;
     virtual ~TaskPromise() = default;
     auto state() const -> TaskState;
+    ///> @brief worker which ran the task last, -1 if not run yet
     auto workerId() const -> int;
-    auto workerIds() const -> const std::vector<int>&;
+    ///> @brief worker the task was queued to first, -1 if never queued
+    auto firstWorkerId() const -> int;
+    ///> @brief worker the task was queued to last, -1 if never queued
+    auto lastWorkerId() const -> int;
+    /**
+     * @brief workers of the last placements of the task in a queue, newest first, -1 for the unused entries
+     *
+     * @note
+     * the history is one atomic word, a reader always gets a consistent snapshot even while the task is re-queued.
+     */
+    auto workerHistory() const -> std::array<int, kWorkerHistorySize>;
+    ///> @brief count of times the task was queued to a worker, each retry and steal queues it again
+    auto placementCount() const -> uint32_t;
+    ///> @brief count of placements on another worker than the previous one
+    auto migrationCount() const -> uint32_t;
     auto cancel() -> int;
+    /**
+     * @brief ask the task to stop
+     *
+     * a queuing task is cancelled at once, a running task can see it by cancellationToken() and finish early, it
+     * will end in Cancelled state.
+     *
+     * @param withDependents also request all tasks depending on this one directly or indirectly to stop, every task of
+     * the downstream subgraph is visited once.
+     * @return int count of tasks newly requested to stop
+     */
+    auto requestCancel(const bool withDependents = true) -> int;
+    auto isCancelRequested() const -> bool;
+    auto cancellationToken() const -> CancellationToken;
+    /**
+     * @brief register a task depending on this one, so it can be cancelled with this one.
+     *
+     * @return int -1 if the cancel of this task is already requested, the dependent should not run.
+     */
+    auto addDependent(std::weak_ptr<TaskPromise> dependent) -> int;
+    ///> @brief unregister dependent, e.g. it finished and the cancel of this task can not reach it anymore
+    auto removeDependent(const TaskPromise* dependent) -> void;
+    ///> @brief count of registered dependents, expired ones included
+    auto dependentCount() -> std::size_t;
     auto changeState(const TaskState old, const TaskState newstate) -> int;
     auto resetState() -> int;
     auto done() -> int;
@@ -29,11 +102,21 @@ public:
     auto userData(void* data) -> void;
     auto taskId() -> uint64_t;
     auto taskId(uint64_t id) -> void;
-#if LLWFLOWS_CPP_PLUS >= 20
+    /**
+     * @brief wait until the task is finished (Done or Cancelled), a worker thread keeps running other tasks meanwhile.
+     *
+     * @note
+     * another thread blocks on the state word itself and is counted as a waiter, the transitions of a promise nobody
+     * waits for do not wake anything.
+     */
     auto wait() -> TaskState;
+    ///> @brief wait at most timeout, return the state at that time, which is still pending if it timed out
+    auto waitFor(const std::chrono::nanoseconds timeout) -> TaskState;
+    auto waitUntil(const std::chrono::steady_clock::time_point deadline) -> TaskState;
+    ///> @brief count of threads blocked in a wait of this promise
+    auto waiterCount() const -> int;
     auto notifyOne() -> void;
     auto notifyAll() -> void;
-#endif
 protected:
     /**
      * @brief state of the task
@@ -46,21 +129,90 @@ protected:
      */
     auto mutableState() -> std::atomic<TaskState>&;
     auto mutableWorkerId() -> std::atomic<int>&;
-    auto mutableWorkerIds() -> std::vector<int>&;
+    /**
+     * @brief record that the task is queued to workerId
+     *
+     * @note
+     * only the thread posting the task records it, before the task is visible in a queue.
+     *
+     * @return uint64_t the history before, restoreWorkerHistory() takes it back if the post failed
+     */
+    auto recordWorker(const int workerId) -> uint64_t;
+    auto restoreWorkerHistory(const uint64_t history) -> void;
+    auto resetWorkerHistory() -> void;
+    ///> @brief called once when the cancel of this task is requested
+    virtual auto onCancelRequested() -> void {}
     friend class ThreadWorker;
+    friend class ExecutionPlan;
 
 private:
     TaskPromise(TaskPromise&&)                 = delete;
     TaskPromise(const TaskPromise&)            = delete;
     TaskPromise& operator=(TaskPromise&&)      = delete;
     TaskPromise& operator=(const TaskPromise&) = delete;
+    ///> @brief wake the waiters if there are any, called after every transition a waiter may wait for
+    auto wakeWaiters() -> void;
 
 private:
-    std::atomic<TaskState> mState{TaskState::Queuing};
-    std::atomic<int>       mWorkerId{-1};
-    std::vector<int>       mWorkerIds;
-    uint64_t               mTaskId   = 0;
-    void*                  mUserData = nullptr;
+    std::atomic<TaskState>                  mState{TaskState::Queuing};
+    std::atomic<uint32_t>                   mWaiters{0};
+    std::atomic<int>                        mWorkerId{-1};
+    std::atomic<uint64_t>                   mWorkerHistory{0};  ///> 16 bits of worker id + 1 each, newest lowest
+    std::atomic<int>                        mFirstWorkerId{-1};
+    std::atomic<uint32_t>                   mPlacementCount{0};
+    std::atomic<uint32_t>                   mMigrationCount{0};
+    uint64_t                                mTaskId   = 0;
+    void*                                   mUserData = nullptr;
+    std::atomic<bool>                       mCancelRequested{false};
+    detail::SpinLock                        mDependentsLock;
+    std::vector<std::weak_ptr<TaskPromise>> mDependents;
+};
+
+/**
+ * @brief promise done once it was counted down to zero
+ *
+ * many tasks count down the same latch when they finish (TaskDescription::latch), so a fan-in of N tasks is one
+ * dependency checked in O(1) and one wait target, instead of N of each.
+ *
+ * @note
+ * it is Running while the count is above zero and Done at zero, it can not be reset. a task counts down when it is
+ * finished, done or cancelled. a pool parks the tasks depending on a latch on it by onDone(), instead of retrying them.
+ */
+class TaskLatch : public TaskPromise {
+public:
+    explicit TaskLatch(const int64_t count) noexcept;
+    ~TaskLatch() override = default;
+    static auto create(const int64_t count) -> std::shared_ptr<TaskLatch>;
+
+    ///> @brief return the count left, the latch is done when it reaches zero
+    auto countDown(const int64_t n = 1) -> int64_t;
+    ///> @brief expect n more count downs, return -1 if the latch is already done
+    auto add(const int64_t n = 1) -> int;
+    auto count() const -> int64_t;
+    /**
+     * @brief call func once the latch is done, from the thread counting it down to zero
+     *
+     * @note
+     * it is called at once if the latch is already done, and early if the cancel of the latch is requested.
+     * @return int count of functions parked before func, -1 if func was called at once
+     */
+    auto onDone(std::function<void()> func) -> int;
+    ///> @brief count of functions waiting in onDone()
+    auto parkedCount() -> std::size_t;
+    /**
+     * @brief call the functions waiting in onDone() now, e.g. when the pool of the parked tasks stops
+     * @note only the first call (or the count down to zero) does it, later onDone() calls func at once.
+     */
+    auto releaseParked() -> void;
+
+protected:
+    auto onCancelRequested() -> void override;
+
+private:
+    std::atomic<int64_t>               mCount;
+    detail::SpinLock                   mParkedLock;
+    std::vector<std::function<void()>> mParked;
+    bool                               mReleased{false};  ///> under mParkedLock, no function is parked anymore
 };
 
 struct Task {
@@ -77,6 +229,20 @@ struct Task {
 
 class LLWFLOWS_API ThreadWorker : Thread {
 public:
+    using TaskQueue      = SRingBuffer<Task, LLWFLOWS_WORKER_QUEUE_POLICY>;
+    using LocalTaskQueue = detail::WorkStealingDeque<Task>;
+    ///> @brief whether other threads can pop from the task queue, work stealing needs it.
+    static constexpr bool kStealable = TaskQueue::PolicyType::kMultiConsumer;
+    ///> @brief upper bound of tasks the worker claims from its queue with one atomic operation.
+    static constexpr int kMaxBatchSize = 32;
+    ///> @brief count of priority lanes of the shared queue, lane 0 runs first.
+    static constexpr int kPriorityLevels  = 3;
+    static constexpr int kDefaultPriority = 1;
+    ///> @brief a queued task is promoted by one priority level per interval it waits by default.
+    static constexpr std::chrono::nanoseconds kDefaultAgingInterval = std::chrono::milliseconds(20);
+    ///> @brief longest a worker blocked in helpWhile() sleeps before it looks for tasks to steal again.
+    static constexpr std::chrono::nanoseconds kHelpBlockSlice = std::chrono::milliseconds(1);
+
     ThreadWorker(const int workerId = -1, const int maxQueueSize = 1024, const int maxIdleLoopCount = 0xffffff);
     ~ThreadWorker() override = default;
 
@@ -85,13 +251,79 @@ public:
     auto workerId() const -> int;
     auto post(std::function<void()> func) -> std::shared_ptr<TaskPromise>;
     auto post(std::function<void()> func, std::shared_ptr<TaskPromise> taskPromise) -> int;
+    /**
+     * @brief post task to the lane of priority, the task is left untouched if the lane is full so it can be posted to
+     * another worker.
+     */
+    auto post(Task&& task, const int priority = kDefaultPriority) -> int;
+    /**
+     * @brief push task to the local LIFO queue of this worker, it runs before the tasks in the shared queue.
+     * @note must be called from the thread of this worker, other workers can only take it by stealLocal().
+     */
+    auto postLocal(Task&& task) -> int;
+    ///> @brief take the oldest task of the local queue, can be called by any thread.
+    auto stealLocal(Task& task) -> bool;
+    auto localTaskCount() const -> int;
+    ///> @brief wake the worker if it is sleeping, so it goes through the idle loop (and steals) again.
+    auto notifyIdle() -> void;
+    auto isSleeping() const -> bool;
     auto waitForExit() -> void;
     auto exit(bool AfterTaskInQueue = false) -> void;
-    auto taskQueue() -> SRingBuffer<Task>&;
+    auto taskQueue(const int priority = kDefaultPriority) -> TaskQueue&;
+    ///> @brief count of tasks in all lanes of the shared queue
+    auto queuedTaskCount() const -> std::size_t;
+    /**
+     * @brief take the next task of the shared queue, can be called by any thread.
+     *
+     * the first non empty lane is taken, unless the task at the head of a lower lane aged past it: a lane gains one
+     * level per aging interval since it was last served while other lanes had tasks, so a saturated High lane delays a
+     * Low task by at most two intervals.
+     */
+    auto pop(Task& task) -> bool;
+    /**
+     * @brief set the wait which promotes a queued task by one priority level, 0 for strict priority.
+     * @note strict priority can starve the lower lanes forever under a steady stream of higher work.
+     */
+    auto setAgingInterval(const std::chrono::nanoseconds interval) -> void;
+    auto agingInterval() const -> std::chrono::nanoseconds;
     auto idleLoopCount() -> int;
     auto maxIdleLoopCount() -> int;
     auto registerCallbackInIdleLoop(std::function<void(const int workId, const int count)> func) -> void;
+    ///> @brief callback to take a task from other workers, used by helpWhile() when the own queues are empty.
+    auto registerStealCallback(std::function<bool(const int workId, Task& task)> func) -> void;
+    /**
+     * @brief callback given a task which is not finished by this worker: dropped cancelled, or returned in a custom
+     * state. it may take the task to queue it again, or release what waits for the task.
+     */
+    auto registerUnfinishedCallback(std::function<bool(const int workId, Task& task)> func) -> void;
+    /**
+     * @brief run queued tasks of this worker (local first), or stolen ones, while pending() is true
+     *
+     * a worker blocked on a child would waste its thread, and deadlock the pool if the child sits in its own queue.
+     * once nothing was runnable for a while, block() is called instead of spinning on, it should sleep by blockOn().
+     *
+     * @note must be called from the thread of this worker.
+     */
+    auto helpWhile(const std::function<bool()>& pending, const std::function<void()>& block = nullptr) -> void;
+    /**
+     * @brief sleep while word holds expected, until woken on it, a task is posted to this worker, or deadline
+     * @note must be called from the thread of this worker, the waker of word is not required to know about it.
+     */
+    auto blockOn(std::atomic<TaskState>& word, const TaskState expected,
+                 const std::chrono::steady_clock::time_point deadline) -> void;
     auto isIdle() -> bool;
+    /**
+     * @brief set how many tasks the worker claims per pop, clamped to [1, kMaxBatchSize].
+     * @note tasks claimed by a worker can not be stolen, a small batch keeps the load fair between workers.
+     */
+    auto setBatchSize(const int batchSize) -> void;
+    auto batchSize() const -> int;
+    ///> @brief promise of the task running in the calling thread, nullptr if not in a worker task.
+    static auto currentTaskPromise() -> TaskPromise*;
+    ///> @brief token of the task running in the calling thread, never cancelled if not in a worker task.
+    static auto currentCancellationToken() -> CancellationToken;
+    ///> @brief worker running the calling thread, nullptr if not a worker thread.
+    static auto currentWorker() -> ThreadWorker*;
 
     using Thread::isRunning;
     using Thread::maxPriority;
@@ -101,6 +333,18 @@ public:
 
 protected:
     void run() override;
+    auto runTask(Task& task) -> void;
+    ///> @brief cancel a task which will not run, e.g. the worker exits, and hand it to the unfinished callback
+    auto dropTask(Task& task) -> void;
+    auto wakeUp() -> void;
+    /**
+     * @brief lane to take the next tasks from by effective priority, -1 if all lanes are empty
+     * @param aged set if it is not the first non empty lane, only one task should be taken then.
+     */
+    auto pickLane(bool& aged) -> int;
+    ///> @brief take up to count tasks of the lane picked by pickLane(), a lane which aged past the others gives one
+    auto popBatch(Task* tasks, const std::size_t count) -> std::size_t;
+    auto queuesEmpty() const -> bool;
 
 private:
     ThreadWorker(const ThreadWorker&)                    = delete;
@@ -113,12 +357,24 @@ private:
     int                                       mWorkerId{-1};
     std::atomic<bool>                         mExit{false};
     std::atomic<bool>                         mExitAfterAllTasks{false};
-    SRingBuffer<Task>                         mTasks;
+    TaskQueue                                 mTasks[kPriorityLevels];
+    ///> steady clock ns since the head of each lane waits behind other lanes, 0 if it does not wait.
+    std::atomic<int64_t>                      mLaneWaitSince[kPriorityLevels]{};
+    std::atomic<int64_t>                      mAgingInterval{kDefaultAgingInterval.count()};
+    LocalTaskQueue                            mLocalTasks;
     std::mutex                                mMutex;
     std::condition_variable                   mConditionVar;
+    std::atomic<bool>                         mSleeping{false};
+    std::atomic<bool>                         mHelpBlocked{false};
+    detail::SpinLock                          mHelpBlockLock;
+    std::atomic<TaskState>*                   mHelpBlockWord{nullptr};  ///> word blockOn() sleeps on, under the lock
+    std::atomic<bool>                         mIdleNotified{false};
     std::atomic<int>                          mIdleLoopCount{0};
     const int                                 mMaxIdleLoopCount{0xffffff};
+    std::atomic<int>                          mBatchSize{8};
     std::function<void(const int, const int)> mCallbackInIdleLoop;
+    std::function<bool(const int, Task&)>     mStealCallback;
+    std::function<bool(const int, Task&)>     mUnfinishedCallback;
 };
 
 LLWFLOWS_NS_END
\ No newline at end of file
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "detail/workflowsglobal.hpp"
+
+#if LLWFLOWS_CPP_PLUS >= 20
+#include <bit>
+#endif
+
+LLWFLOWS_NS_BEGIN
+
+/**
+ * @brief hierarchical timing wheel
+ *
+ * kLevels wheels of kSlots slots each, the level L slot covers kSlots^L ticks. A timer is put in the lowest level that
+ * can hold its distance to the current tick and cascades down one level each time the wheel above turns. so schedule
+ * and expire are O(1) and advancing is O(expired + cascaded) with empty stretches skipped by the occupancy bitmaps.
+ *
+ * @note this class is not thread safe, the owner should guard it.
+ * nodes come from a free list grown in chunks, so a million pending timers cost a million nodes and no more.
+ *
+ * @tparam T payload of timer
+ */
+template <typename T>
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int      kSlotBits = 6;
+    static constexpr int      kSlots    = 1 << kSlotBits;
+    static constexpr int      kLevels   = 6;
+    static constexpr uint64_t kSlotMask = kSlots - 1;
+    static constexpr uint64_t kMaxDelta = (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+
+    TimerWheel(std::chrono::nanoseconds tick = std::chrono::milliseconds(1), Clock::time_point start = Clock::now());
+    ~TimerWheel();
+
+    auto schedule(Clock::time_point deadline, T value) -> void;
+    /**
+     * @brief advance the wheel to now and hand out every expired payload
+     *
+     * @param now
+     * @param onExpired void(Clock::time_point deadline, T&& value)
+     * @return int count of expired timers
+     */
+    template <typename Func>
+    auto advance(Clock::time_point now, Func&& onExpired) -> int;
+    ///> @brief drop all pending timers, onDropped is called with every payload
+    template <typename Func>
+    auto clear(Func&& onDropped) -> void;
+    ///> @brief time point of the next tick need to be processed, Clock::time_point::max() if wheel is empty
+    auto nextExpiry() const -> Clock::time_point;
+    auto size() const -> std::size_t;
+    auto empty() const -> bool;
+    auto tick() const -> std::chrono::nanoseconds;
+
+private:
+    struct Node {
+        uint64_t expire = 0;
+        Node*    next   = nullptr;
+        T        value;
+    };
+
+    TimerWheel(const TimerWheel&)                    = delete;
+    auto operator=(const TimerWheel&) -> TimerWheel& = delete;
+
+    auto toTick(Clock::time_point timePoint, const bool roundUp) const -> uint64_t;
+    auto toTimePoint(uint64_t tick) const -> Clock::time_point;
+    auto place(Node* node, const uint64_t earliest) -> void;
+    template <typename Func>
+    auto expire(Node* node, Func& onExpired) -> void;
+    auto cascade(const int level) -> void;
+    auto allocNode() -> Node*;
+    static auto countTrailingZero(uint64_t bits) -> int;
+    auto freeNode(Node* node) -> void;
+
+private:
+    static constexpr int                           kChunkSize = 1024;
+    std::chrono::nanoseconds                       mTick;
+    Clock::time_point                              mStart;
+    uint64_t                                       mCurrentTick = 0;
+    std::size_t                                    mSize        = 0;
+    std::array<std::array<Node*, kSlots>, kLevels> mSlots{};
+    std::array<uint64_t, kLevels>                  mOccupied{};
+    Node*                                          mFreeList = nullptr;
+    std::vector<std::unique_ptr<Node[]>>           mChunks;
+};
+
+template <typename T>
+TimerWheel<T>::TimerWheel(std::chrono::nanoseconds tick, Clock::time_point start)
+    : mTick(tick.count() > 0 ? tick : std::chrono::nanoseconds(1)), mStart(start) {}
+
+template <typename T>
+TimerWheel<T>::~TimerWheel() {
+    clear([](Clock::time_point, T&&) {});
+}
+
+template <typename T>
+auto TimerWheel<T>::schedule(Clock::time_point deadline, T value) -> void {
+    auto node    = allocNode();
+    node->expire = toTick(deadline, true);
+    node->value  = std::move(value);
+    place(node, mCurrentTick + 1);
+    ++mSize;
+}
+
+template <typename T>
+template <typename Func>
+auto TimerWheel<T>::advance(Clock::time_point now, Func&& onExpired) -> int {
+    const auto target = toTick(now, false);
+    const auto before = mSize;
+    while (mCurrentTick < target) {
+        if (mSize == 0) {
+            mCurrentTick = target;
+            break;
+        }
+        // nothing in level 0, jump to the end of this turn, the next tick will cascade from upper levels.
+        if (mOccupied[0] == 0) {
+            auto turnEnd = mCurrentTick | kSlotMask;
+            if (turnEnd >= target) {
+                mCurrentTick = target;
+                break;
+            }
+            mCurrentTick = turnEnd;
+        }
+        ++mCurrentTick;
+        const auto idx = mCurrentTick & kSlotMask;
+        if (idx == 0) {
+            cascade(1);
+        }
+        Node* node = mSlots[0][idx];
+        if (node != nullptr) {
+            mSlots[0][idx] = nullptr;
+            mOccupied[0] &= ~(uint64_t(1) << idx);
+            expire(node, onExpired);
+        }
+    }
+    return static_cast<int>(before - mSize);
+}
+
+template <typename T>
+template <typename Func>
+auto TimerWheel<T>::clear(Func&& onDropped) -> void {
+    for (auto& level : mSlots) {
+        for (auto& slot : level) {
+            for (Node* node = slot; node != nullptr;) {
+                Node* next = node->next;
+                onDropped(toTimePoint(node->expire), std::move(node->value));
+                freeNode(node);
+                node = next;
+            }
+            slot = nullptr;
+        }
+    }
+    mOccupied.fill(0);
+    mSize = 0;
+}
+
+template <typename T>
+auto TimerWheel<T>::nextExpiry() const -> Clock::time_point {
+    if (mSize == 0) {
+        return Clock::time_point::max();
+    }
+    const auto idx = mCurrentTick & kSlotMask;
+    // slots after the current one in this turn of level 0.
+    const auto later = idx == kSlotMask ? 0 : mOccupied[0] & (~uint64_t(0) << (idx + 1));
+    if (later != 0) {
+        return toTimePoint((mCurrentTick & ~kSlotMask) + countTrailingZero(later));
+    }
+    // otherwise wake up at the start of next turn, where either level 0 wraps or upper levels cascade.
+    return toTimePoint((mCurrentTick | kSlotMask) + 1);
+}
+
+template <typename T>
+auto TimerWheel<T>::size() const -> std::size_t {
+    return mSize;
+}
+
+template <typename T>
+auto TimerWheel<T>::empty() const -> bool {
+    return mSize == 0;
+}
+
+template <typename T>
+auto TimerWheel<T>::tick() const -> std::chrono::nanoseconds {
+    return mTick;
+}
+
+template <typename T>
+auto TimerWheel<T>::toTick(Clock::time_point timePoint, const bool roundUp) const -> uint64_t {
+    if (timePoint <= mStart) {
+        return 0;
+    }
+    // deadlines round up and now rounds down, so a timer never fires before its deadline.
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint - mStart).count();
+    return (elapsed + (roundUp ? mTick.count() - 1 : 0)) / mTick.count();
+}
+
+template <typename T>
+auto TimerWheel<T>::toTimePoint(uint64_t tick) const -> Clock::time_point {
+    return mStart + std::chrono::duration_cast<Clock::duration>(mTick * tick);
+}
+
+template <typename T>
+auto TimerWheel<T>::place(Node* node, const uint64_t earliest) -> void {
+    // already due timers go to the earliest tick still to be processed.
+    auto expire = node->expire > earliest ? node->expire : earliest;
+    auto delta  = expire - mCurrentTick;
+    if (delta > kMaxDelta) {
+        // out of range, park it in the farthest slot, it will be placed again by cascade.
+        expire = mCurrentTick + kMaxDelta;
+        delta  = kMaxDelta;
+    }
+    int level = 0;
+    while (level + 1 < kLevels && delta >= (uint64_t(1) << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    const auto idx     = (expire >> (kSlotBits * level)) & kSlotMask;
+    node->next         = mSlots[level][idx];
+    mSlots[level][idx] = node;
+    mOccupied[level] |= uint64_t(1) << idx;
+}
+
+template <typename T>
+template <typename Func>
+auto TimerWheel<T>::expire(Node* node, Func& onExpired) -> void {
+    while (node != nullptr) {
+        Node* next = node->next;
+        --mSize;
+        onExpired(toTimePoint(node->expire), std::move(node->value));
+        freeNode(node);
+        node = next;
+    }
+}
+
+template <typename T>
+auto TimerWheel<T>::cascade(const int level) -> void {
+    if (level >= kLevels) {
+        return;
+    }
+    const auto idx = (mCurrentTick >> (kSlotBits * level)) & kSlotMask;
+    if (idx == 0) {
+        cascade(level + 1);
+    }
+    Node* node = mSlots[level][idx];
+    if (node == nullptr) {
+        return;
+    }
+    mSlots[level][idx] = nullptr;
+    mOccupied[level] &= ~(uint64_t(1) << idx);
+    while (node != nullptr) {
+        Node* next = node->next;
+        // the level 0 slot of current tick is processed right after cascading.
+        place(node, mCurrentTick);
+        node = next;
+    }
+}
+
+template <typename T>
+auto TimerWheel<T>::countTrailingZero(uint64_t bits) -> int {
+#if LLWFLOWS_CPP_PLUS >= 20
+    return std::countr_zero(bits);
+#elif defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int count = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+template <typename T>
+auto TimerWheel<T>::allocNode() -> Node* {
+    if (mFreeList == nullptr) {
+        mChunks.emplace_back(new Node[kChunkSize]);
+        auto chunk = mChunks.back().get();
+        for (int i = 0; i < kChunkSize; ++i) {
+            chunk[i].next = mFreeList;
+            mFreeList     = &chunk[i];
+        }
+    }
+    Node* node = mFreeList;
+    mFreeList  = node->next;
+    node->next = nullptr;
+    return node;
+}
+
+template <typename T>
+auto TimerWheel<T>::freeNode(Node* node) -> void {
+    node->value = T();
+    node->next  = mFreeList;
+    mFreeList   = node;
+}
+
+LLWFLOWS_NS_END